@@ -0,0 +1,124 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+static void *rad_default_alloc(size_t size, void *userdata){
+	return malloc(size);
+}
+
+static void rad_default_free(void *ptr, void *userdata){
+	free(ptr);
+}
+
+static void *(*rad_alloc_func)(size_t, void *) = rad_default_alloc;
+static void (*rad_free_func)(void *, void *) = rad_default_free;
+static void *rad_alloc_userdata = NULL;
+
+//Memory for RAD functions is allocated through these hooks. Passing NULL restores malloc and free.
+//A RAD function must be discarded while the allocator which created it is still installed.
+void rad_set_allocator(void *(*alloc_func)(size_t, void *), void (*free_func)(void *, void *), void *userdata){
+	if(alloc_func == NULL || free_func == NULL){
+		rad_alloc_func = rad_default_alloc;
+		rad_free_func = rad_default_free;
+		rad_alloc_userdata = NULL;
+	} else {
+		rad_alloc_func = alloc_func;
+		rad_free_func = free_func;
+		rad_alloc_userdata = userdata;
+	}
+}
+
+void *rad_malloc(size_t size){
+#ifdef RAD_PROFILE
+	rad_profile_add(&rad_profile_data.allocations, 1);
+#endif
+	return rad_alloc_func(size, rad_alloc_userdata);
+}
+
+void rad_free(void *ptr){
+#ifdef RAD_PROFILE
+	rad_profile_add(&rad_profile_data.frees, 1);
+#endif
+	rad_free_func(ptr, rad_alloc_userdata);
+}
+
+typedef struct rad_arena_block rad_arena_block;
+
+struct rad_arena_block{
+	rad_arena_block *next;
+	size_t size;
+};
+
+struct rad_arena{
+	rad_arena_block *blocks;
+	size_t block_size;
+	char *next;
+	size_t remaining;
+};
+
+#define RAD_ARENA_ALIGN 16
+#define RAD_ARENA_HEADER ((sizeof(rad_arena_block) + RAD_ARENA_ALIGN - 1)/RAD_ARENA_ALIGN*RAD_ARENA_ALIGN)
+
+rad_arena *rad_arena_create(size_t block_size){
+	rad_arena *output;
+
+	output = malloc(sizeof(rad_arena));
+	output->blocks = NULL;
+	output->block_size = block_size ? block_size : 65536;
+	output->next = NULL;
+	output->remaining = 0;
+
+	return output;
+}
+
+//Bump allocation out of the current block. Each new block is twice as large as the last,
+//so a graph of n nodes lives in O(log n) blocks.
+void *rad_arena_alloc(size_t size, void *userdata){
+	rad_arena *arena;
+	rad_arena_block *block;
+	void *output;
+
+	arena = userdata;
+	size = (size + RAD_ARENA_ALIGN - 1)/RAD_ARENA_ALIGN*RAD_ARENA_ALIGN;
+	if(size > arena->remaining){
+		if(arena->blocks != NULL){
+			arena->block_size *= 2;
+		}
+		while(arena->block_size < size){
+			arena->block_size *= 2;
+		}
+		block = malloc(RAD_ARENA_HEADER + arena->block_size);
+		if(block == NULL){
+			return NULL;
+		}
+		block->next = arena->blocks;
+		block->size = arena->block_size;
+		arena->blocks = block;
+		arena->next = (char *) block + RAD_ARENA_HEADER;
+		arena->remaining = arena->block_size;
+	}
+
+	output = arena->next;
+	arena->next += size;
+	arena->remaining -= size;
+
+	return output;
+}
+
+void rad_arena_free(void *ptr, void *userdata){
+	//Arena memory is only released all at once by rad_arena_destroy
+}
+
+//Releases every RAD function allocated from the arena without visiting the nodes
+void rad_arena_destroy(rad_arena *arena){
+	rad_arena_block *block;
+	rad_arena_block *next;
+
+	for(block = arena->blocks; block != NULL; block = next){
+		next = block->next;
+		free(block);
+	}
+	free(arena);
+}
@@ -0,0 +1,356 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "../rad.h"
+
+//Times construction, parsing, the evaluators, copying and discarding on parametric graphs, and writes one CSV row per
+//graph and operation. Every row reports the best time per call over several blocks, which is less sensitive to other
+//load than the mean, the RAD allocations made per call, and the peak resident size of the process so far.
+//An argument restricts the run to the graphs whose names start with it.
+
+#define BENCH_BLOCKS 5
+#define BENCH_BLOCK_SECONDS 0.02
+
+static unsigned long num_allocations = 0;
+
+static void *counting_alloc(size_t size, void *userdata){
+	num_allocations++;
+	return malloc(size);
+}
+
+static void counting_free(void *ptr, void *userdata){
+	free(ptr);
+}
+
+static double seconds(void){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+static long peak_rss_kb(void){
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+//Sum of size products of neighbouring inputs
+static rad_func *wide_sum(unsigned int size, unsigned int *num_inputs){
+	rad_func *output;
+	unsigned int i;
+
+	output = rad_multiply(rad_input(0), rad_input(1));
+	for(i = 1; i < size; i++){
+		output = rad_add(output, rad_multiply(rad_input(i), rad_input(i + 1)));
+	}
+	*num_inputs = size + 1;
+
+	return output;
+}
+
+//The same function as wide_sum, as text for rad_parse
+static char *wide_sum_text(unsigned int size){
+	char *output;
+	char *c;
+	unsigned int i;
+
+	output = malloc(32*(size + 1));
+	c = output + sprintf(output, "[0]*[1]");
+	for(i = 1; i < size; i++){
+		c += sprintf(c, " + [%u]*[%u]", i, i + 1);
+	}
+
+	return output;
+}
+
+static rad_func *deep_chain(unsigned int size, unsigned int *num_inputs){
+	rad_func *output;
+	unsigned int i;
+
+	output = rad_input(0);
+	for(i = 0; i < size; i++){
+		output = rad_add(output, rad_multiply(rad_input(1), rad_const(1.0/size)));
+	}
+	*num_inputs = 2;
+
+	return output;
+}
+
+//A network of size layers of eight sigmoid neurons, built from scalar nodes
+static rad_func *mlp(unsigned int size, unsigned int *num_inputs){
+	rad_func *layer[8];
+	rad_func *next[8];
+	rad_func *neuron;
+	unsigned int parameter;
+	unsigned int i;
+	unsigned int j;
+	unsigned int k;
+
+	for(i = 0; i < 8; i++){
+		layer[i] = rad_input(i);
+	}
+	parameter = 8;
+	for(k = 0; k < size; k++){
+		for(i = 0; i < 8; i++){
+			neuron = rad_input(parameter++);
+			for(j = 0; j < 8; j++){
+				neuron = rad_add(neuron, rad_multiply(rad_copy(layer[j]), rad_input(parameter++)));
+			}
+			next[i] = rad_sigmoid(neuron);
+		}
+		for(i = 0; i < 8; i++){
+			rad_discard(layer[i]);
+			layer[i] = next[i];
+		}
+	}
+	neuron = layer[0];
+	for(i = 1; i < 8; i++){
+		neuron = rad_add(neuron, layer[i]);
+	}
+	*num_inputs = parameter;
+
+	return neuron;
+}
+
+//The same network as mlp, with a dense layer node for each layer like new_layer in neurons.c
+static rad_func *dense_mlp(unsigned int size, unsigned int *num_inputs){
+	rad_func *layer[8];
+	rad_func *dense;
+	rad_func *output;
+	unsigned int parameter;
+	unsigned int i;
+	unsigned int k;
+
+	for(i = 0; i < 8; i++){
+		layer[i] = rad_input(i);
+	}
+	parameter = 8;
+	for(k = 0; k < size; k++){
+		dense = rad_dense(parameter, 8, 8, layer);
+		parameter += 8*9;
+		for(i = 0; i < 8; i++){
+			layer[i] = rad_sigmoid(rad_dense_output(rad_copy(dense), i));
+		}
+		rad_discard(dense);
+	}
+	output = layer[0];
+	for(i = 1; i < 8; i++){
+		output = rad_add(output, layer[i]);
+	}
+	*num_inputs = parameter;
+
+	return output;
+}
+
+//Every node is used twice by the next, so the graph has exponentially many paths through few nodes
+static rad_func *shared(unsigned int size, unsigned int *num_inputs){
+	rad_func *output;
+	unsigned int i;
+
+	output = rad_input(0);
+	for(i = 0; i < size; i++){
+		output = rad_sin(rad_multiply(rad_copy(output), output));
+	}
+	*num_inputs = 1;
+
+	return output;
+}
+
+//A chain of compositions of one activation function
+static rad_func *compositions(unsigned int size, unsigned int *num_inputs){
+	rad_func *activation;
+	rad_func *output;
+	unsigned int i;
+
+	activation = rad_parse("tanh([0])*[1] + [0]");
+	output = rad_input(0);
+	for(i = 0; i < size; i++){
+		output = rad_composition(rad_copy(activation), 2, output, rad_input(1));
+	}
+	rad_discard(activation);
+	*num_inputs = 2;
+
+	return output;
+}
+
+typedef struct bench_graph bench_graph;
+
+struct bench_graph{
+	const char *name;
+	rad_func *(*create)(unsigned int, unsigned int *);
+	char *(*text)(unsigned int);
+	unsigned int size;
+};
+
+static bench_graph graphs[] = {
+	{"wide_sum", wide_sum, wide_sum_text, 1000},
+	{"wide_sum", wide_sum, wide_sum_text, 100000},
+	{"deep_chain", deep_chain, NULL, 1000},
+	{"deep_chain", deep_chain, NULL, 100000},
+	{"mlp", mlp, NULL, 2},
+	{"mlp", mlp, NULL, 32},
+	{"dense_mlp", dense_mlp, NULL, 2},
+	{"dense_mlp", dense_mlp, NULL, 32},
+	{"shared", shared, NULL, 1000},
+	{"shared", shared, NULL, 100000},
+	{"compositions", compositions, NULL, 100},
+	{"compositions", compositions, NULL, 10000}
+};
+
+enum operation{
+	PARSE,
+	CONSTRUCT,
+	EVAL,
+	FORWARD_GRAD,
+	FORWARD_DIFF,
+	BACKWARD_DIFF,
+	DEEP_COPY,
+	DISCARD
+};
+
+static const char *operation_names[] = {"rad_parse", "construct", "rad_eval", "rad_forward_grad", "rad_forward_diff", "rad_backward_diff", "rad_deep_copy", "rad_discard"};
+
+typedef struct bench_state bench_state;
+
+struct bench_state{
+	bench_graph *graph;
+	rad_func *func;
+	char *text;
+	double *inputs;
+	double *derivatives;
+	unsigned int num_inputs;
+};
+
+//Runs one call of operation and returns the time it took. Graphs which the operation creates or destroys are rebuilt
+//or released outside the timed region.
+static double run_once(bench_state *state, enum operation operation){
+	rad_func *func = NULL;
+	unsigned int num_inputs;
+	double start;
+	double time;
+
+	if(operation == DISCARD){
+		func = state->graph->create(state->graph->size, &num_inputs);
+	}
+
+	start = seconds();
+	switch(operation){
+		case PARSE:
+			func = rad_parse(state->text);
+			break;
+		case CONSTRUCT:
+			func = state->graph->create(state->graph->size, &num_inputs);
+			break;
+		case EVAL:
+			rad_eval(state->func, state->inputs);
+			break;
+		case FORWARD_GRAD:
+			rad_forward_grad(state->func, state->inputs, state->derivatives, NULL);
+			break;
+		case FORWARD_DIFF:
+			rad_forward_diff(state->func, state->inputs, 0, NULL);
+			break;
+		case BACKWARD_DIFF:
+			rad_backward_diff(state->func, state->inputs, state->derivatives);
+			break;
+		case DEEP_COPY:
+			func = rad_deep_copy(state->func);
+			break;
+		case DISCARD:
+			rad_discard(func);
+			func = NULL;
+			break;
+	}
+	time = seconds() - start;
+
+	if(func != NULL){
+		rad_discard(func);
+	}
+
+	return time;
+}
+
+static void run(bench_state *state, enum operation operation, unsigned long num_nodes){
+	unsigned long allocations;
+	unsigned int repeats;
+	unsigned int i;
+	unsigned int j;
+	double time;
+	double best = -1;
+
+	//Calibrate the number of calls per block, and count the allocations of a single call
+	allocations = num_allocations;
+	time = run_once(state, operation);
+	allocations = num_allocations - allocations;
+	if(operation == DISCARD){
+		allocations = 0;
+	}
+	repeats = time > 0 ? BENCH_BLOCK_SECONDS/time : 1000;
+	if(repeats < 1){
+		repeats = 1;
+	} else if(repeats > 1000000){
+		repeats = 1000000;
+	}
+
+	for(i = 0; i < BENCH_BLOCKS; i++){
+		time = 0;
+		for(j = 0; j < repeats; j++){
+			time += run_once(state, operation);
+		}
+		time /= repeats;
+		if(best < 0 || time < best){
+			best = time;
+		}
+	}
+
+	printf("%s,%u,%lu,%s,%.1f,%.3f,%lu,%ld\n", state->graph->name, state->graph->size, num_nodes, operation_names[operation], best*1e9, best*1e9/num_nodes, allocations, peak_rss_kb());
+	fflush(stdout);
+}
+
+int main(int argc, char **argv){
+	bench_state state;
+	unsigned long num_nodes;
+	unsigned int i;
+	unsigned int j;
+
+	rad_set_allocator(counting_alloc, counting_free, NULL);
+	printf("graph,size,nodes,operation,ns_per_call,ns_per_node,allocations,peak_rss_kb\n");
+
+	for(i = 0; i < sizeof(graphs)/sizeof(graphs[0]); i++){
+		state.graph = graphs + i;
+		if(argc > 1 && strncmp(state.graph->name, argv[1], strlen(argv[1]))){
+			continue;
+		}
+
+		//Every node is allocated once, so the allocations made by construction count the distinct nodes
+		num_nodes = num_allocations;
+		state.func = state.graph->create(state.graph->size, &state.num_inputs);
+		num_nodes = num_allocations - num_nodes;
+		state.inputs = malloc(sizeof(double)*state.num_inputs);
+		state.derivatives = calloc(state.num_inputs, sizeof(double));
+		for(j = 0; j < state.num_inputs; j++){
+			state.inputs[j] = ((double) rand())/RAND_MAX;
+		}
+		state.text = state.graph->text != NULL ? state.graph->text(state.graph->size) : NULL;
+
+		if(state.text != NULL){
+			run(&state, PARSE, num_nodes);
+		}
+		for(j = CONSTRUCT; j <= DISCARD; j++){
+			run(&state, j, num_nodes);
+		}
+
+		rad_discard(state.func);
+		free(state.inputs);
+		free(state.derivatives);
+		free(state.text);
+	}
+
+	rad_set_allocator(NULL, NULL, NULL);
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "../rad.h"
+
+//Times the graph evaluators on a shallow network like the one in neurons.c and on a deep chain of additions
+
+static double seconds(void){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+static rad_func *shallow_network(unsigned int width, unsigned int *num_inputs){
+	rad_func **layer;
+	rad_func *neuron;
+	rad_func *output;
+	unsigned int parameter;
+	unsigned int i;
+	unsigned int j;
+
+	layer = malloc(sizeof(rad_func *)*width);
+	parameter = width;
+	for(i = 0; i < width; i++){
+		neuron = rad_input(parameter++);
+		for(j = 0; j < width; j++){
+			neuron = rad_add(neuron, rad_multiply(rad_input(j), rad_input(parameter++)));
+		}
+		layer[i] = rad_sigmoid(neuron);
+	}
+	output = layer[0];
+	for(i = 1; i < width; i++){
+		output = rad_add(output, layer[i]);
+	}
+	free(layer);
+	*num_inputs = parameter;
+
+	return output;
+}
+
+static rad_func *deep_chain(unsigned int depth){
+	rad_func *output;
+	unsigned int i;
+
+	output = rad_input(0);
+	for(i = 0; i < depth; i++){
+		output = rad_add(output, rad_multiply(rad_input(1), rad_const(1.0/depth)));
+	}
+
+	return output;
+}
+
+enum evaluator{
+	EVAL,
+	FORWARD_DIFF,
+	BACKWARD_DIFF
+};
+
+//Returns the best time per call in microseconds over several blocks, which is less sensitive to other load than the mean
+static double best_time(rad_func *func, double *inputs, double *derivatives, enum evaluator evaluator, unsigned int blocks, unsigned int repeats){
+	double start;
+	double time;
+	double best = -1;
+	unsigned int i;
+	unsigned int j;
+
+	for(i = 0; i < blocks; i++){
+		start = seconds();
+		for(j = 0; j < repeats; j++){
+			switch(evaluator){
+				case EVAL:
+					rad_eval(func, inputs);
+					break;
+				case FORWARD_DIFF:
+					rad_forward_diff(func, inputs, 0, NULL);
+					break;
+				case BACKWARD_DIFF:
+					rad_backward_diff(func, inputs, derivatives);
+					break;
+			}
+		}
+		time = (seconds() - start)*1e6/repeats;
+		if(best < 0 || time < best){
+			best = time;
+		}
+	}
+
+	return best;
+}
+
+static void run(const char *name, rad_func *func, unsigned int num_inputs, unsigned int blocks, unsigned int repeats){
+	double *inputs;
+	double *derivatives;
+	double eval_time;
+	double forward_time;
+	double backward_time;
+	unsigned int i;
+
+	inputs = malloc(sizeof(double)*num_inputs);
+	derivatives = calloc(num_inputs, sizeof(double));
+	for(i = 0; i < num_inputs; i++){
+		inputs[i] = ((double) rand())/RAND_MAX;
+	}
+
+	eval_time = best_time(func, inputs, derivatives, EVAL, blocks, repeats);
+	forward_time = best_time(func, inputs, derivatives, FORWARD_DIFF, blocks, repeats);
+	backward_time = best_time(func, inputs, derivatives, BACKWARD_DIFF, blocks, repeats);
+
+	printf("%s: rad_eval %.3f us, rad_forward_diff %.3f us, rad_backward_diff %.3f us\n", name, eval_time, forward_time, backward_time);
+	free(inputs);
+	free(derivatives);
+}
+
+int main(int argc, char **argv){
+	rad_func *func;
+	unsigned int num_inputs;
+
+	func = shallow_network(8, &num_inputs);
+	run("shallow network", func, num_inputs, 20, 10000);
+	rad_discard(func);
+
+	func = deep_chain(1000000);
+	run("chain of depth 1000000", func, 2, 3, 2);
+	rad_discard(func);
+
+	return 0;
+}
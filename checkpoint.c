@@ -0,0 +1,362 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+//The tape is split into segments of segment_length instructions. Slots read by an instruction of a later segment are
+//external, and their values and adjoints are kept for the whole call in ext_values and ext_adjoints. All other values
+//and adjoints only live in the buffers of the segment being computed.
+#define RAD_NOT_EXTERNAL UINT_MAX
+
+//Returns the number of custom function arguments of the instructions start to end - 1, which start at first_arg
+static unsigned int rad_checkpoint_segment_args(rad_tape *tape, unsigned int start, unsigned int end, unsigned int *first_arg){
+	unsigned int last_arg;
+	bool found = false;
+	unsigned int i;
+
+	*first_arg = 0;
+	last_arg = 0;
+	for(i = start; i < end; i++){
+		if(tape->ops[i].operation == CUSTOM){
+			if(!found){
+				*first_arg = tape->ops[i].first_input;
+				found = true;
+			}
+			last_arg = tape->ops[i].first_input + tape->ops[i].num_inputs;
+		}
+	}
+
+	return last_arg - *first_arg;
+}
+
+//Bytes of the arrays of a tape, which stay resident while it is evaluated
+static size_t rad_tape_memory(rad_tape *tape){
+	size_t num_indices;
+
+	num_indices = tape->num_args + tape->num_ops + 1 + tape->user_start[tape->num_ops] + 1 + tape->num_inputs + 1 + tape->input_start[tape->num_inputs] + 1;
+	return sizeof(rad_tape) + sizeof(rad_tape_op)*tape->num_ops + sizeof(unsigned int)*num_indices;
+}
+
+//Marks the external slots for segments of the given length and returns the bytes a call would use, counting the tape
+static size_t rad_checkpoint_plan(rad_tape *tape, unsigned int segment_length, unsigned int *external, unsigned int *num_external, unsigned int *max_args){
+	unsigned int *operands;
+	unsigned int pair[2];
+	unsigned int num_operands;
+	unsigned int num_ops;
+	unsigned int first_arg;
+	unsigned int num_args;
+	unsigned int start;
+	unsigned int i;
+	unsigned int j;
+
+	num_ops = tape->output + 1;
+	for(i = 0; i < num_ops; i++){
+		external[i] = RAD_NOT_EXTERNAL;
+	}
+	*num_external = 0;
+	for(i = 0; i < num_ops; i++){
+		num_operands = rad_tape_operands(tape, tape->ops + i, &operands, pair);
+		for(j = 0; j < num_operands; j++){
+			if(operands[j]/segment_length != i/segment_length && external[operands[j]] == RAD_NOT_EXTERNAL){
+				external[operands[j]] = 0;
+				++*num_external;
+			}
+		}
+	}
+
+	*max_args = 0;
+	for(start = 0; start < num_ops; start += segment_length){
+		num_args = rad_checkpoint_segment_args(tape, start, start + segment_length < num_ops ? start + segment_length : num_ops, &first_arg);
+		if(num_args > *max_args){
+			*max_args = num_args;
+		}
+	}
+
+	return sizeof(rad_checkpoint) + sizeof(unsigned int)*num_ops + 2*sizeof(double)*(*num_external + 1) + 2*sizeof(double)*segment_length + sizeof(double)*(*max_args + 1 + tape->max_custom_inputs + 1) + rad_tape_memory(tape);
+}
+
+//Plans a checkpointed reverse mode for a tape, choosing the longest segments for which the tape and the buffers of the
+//plan fit in memory_budget bytes. If no segment length fits, the one using the least memory is chosen.
+//checkpoint->memory gives the bytes resident during a call. The context the rad_tape_* functions keep in the tape is
+//released. Returns NULL if the buffers cannot be allocated.
+rad_checkpoint *rad_checkpoint_create(/*not consumed*/rad_tape *tape, size_t memory_budget){
+	rad_checkpoint *output;
+	unsigned int num_ops;
+	unsigned int segment_length;
+	unsigned int best_length;
+	unsigned int num_external;
+	unsigned int max_args;
+	unsigned int i;
+	size_t memory;
+	size_t best_memory = 0;
+
+	if(tape->ctx != NULL){
+		rad_ctx_free(tape->ctx);
+		tape->ctx = NULL;
+	}
+	output = malloc(sizeof(rad_checkpoint));
+	if(output == NULL){
+		return NULL;
+	}
+	output->tape = tape;
+	num_ops = tape->output + 1;
+	output->external = malloc(sizeof(unsigned int)*num_ops);
+	if(output->external == NULL){
+		free(output);
+		return NULL;
+	}
+
+	//Longer segments do not recompute more, so the longest which fits is best
+	best_length = num_ops;
+	segment_length = num_ops;
+	while(1){
+		memory = rad_checkpoint_plan(tape, segment_length, output->external, &num_external, &max_args);
+		if(memory <= memory_budget){
+			best_length = segment_length;
+			break;
+		}
+		if(best_memory == 0 || memory < best_memory){
+			best_memory = memory;
+			best_length = segment_length;
+		}
+		if(segment_length == 1){
+			break;
+		}
+		segment_length = (segment_length + 1)/2;
+	}
+
+	output->segment_length = best_length;
+	output->memory = rad_checkpoint_plan(tape, best_length, output->external, &num_external, &max_args);
+	output->num_external = 0;
+	for(i = 0; i < num_ops; i++){
+		if(output->external[i] != RAD_NOT_EXTERNAL){
+			output->external[i] = output->num_external++;
+		}
+	}
+	output->ext_values = malloc(sizeof(double)*(num_external + 1));
+	output->ext_adjoints = malloc(sizeof(double)*(num_external + 1));
+	output->values = malloc(sizeof(double)*best_length);
+	output->adjoints = malloc(sizeof(double)*best_length);
+	output->partials = malloc(sizeof(double)*(max_args + 1));
+	output->scratch = malloc(sizeof(double)*(tape->max_custom_inputs + 1));
+	if(output->ext_values == NULL || output->ext_adjoints == NULL || output->values == NULL || output->adjoints == NULL || output->partials == NULL || output->scratch == NULL){
+		rad_checkpoint_free(output);
+		return NULL;
+	}
+
+	return output;
+}
+
+void rad_checkpoint_free(rad_checkpoint *checkpoint){
+	free(checkpoint->external);
+	free(checkpoint->ext_values);
+	free(checkpoint->ext_adjoints);
+	free(checkpoint->values);
+	free(checkpoint->adjoints);
+	free(checkpoint->partials);
+	free(checkpoint->scratch);
+	free(checkpoint);
+}
+
+static inline double rad_checkpoint_value(rad_checkpoint *checkpoint, unsigned int slot, unsigned int start){
+	if(slot >= start){
+		return checkpoint->values[slot - start];
+	}
+	return checkpoint->ext_values[checkpoint->external[slot]];
+}
+
+static inline double *rad_checkpoint_adjoint(rad_checkpoint *checkpoint, unsigned int slot, unsigned int start){
+	if(slot >= start){
+		return checkpoint->adjoints + slot - start;
+	}
+	return checkpoint->ext_adjoints + checkpoint->external[slot];
+}
+
+//Computes the values of the instructions start to end - 1 into the segment buffer, and copies the external ones out
+static void rad_checkpoint_forward(rad_checkpoint *checkpoint, double *inputs, unsigned int start, unsigned int end){
+	rad_tape *tape;
+	rad_tape_op *op;
+	double *values;
+	double *partials;
+	double x;
+	double y;
+	unsigned int first_arg;
+	unsigned int i;
+	unsigned int j;
+
+	tape = checkpoint->tape;
+	values = checkpoint->values;
+	partials = checkpoint->partials;
+	rad_checkpoint_segment_args(tape, start, end, &first_arg);
+	for(i = start; i < end; i++){
+		op = tape->ops + i;
+		switch(op->operation){
+			case CONSTANT:
+				values[i - start] = op->const_value;
+				break;
+			case INPUT:
+				values[i - start] = inputs[op->input_id];
+				break;
+			case ADD:
+			case SUBTRACT:
+			case MULTIPLY:
+			case DIVIDE:
+			case POW:
+				x = rad_checkpoint_value(checkpoint, op->operand0, start);
+				y = rad_checkpoint_value(checkpoint, op->operand1, start);
+				switch(op->operation){
+					case ADD:
+						values[i - start] = x + y;
+						break;
+					case SUBTRACT:
+						values[i - start] = x - y;
+						break;
+					case MULTIPLY:
+						values[i - start] = x*y;
+						break;
+					case DIVIDE:
+						values[i - start] = x/y;
+						break;
+					default:
+						values[i - start] = pow(x, y);
+						break;
+				}
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				values[i - start] = rad_unary_eval(op->operation, rad_checkpoint_value(checkpoint, op->operand0, start));
+				break;
+			case CUSTOM:
+				for(j = 0; j < op->num_inputs; j++){
+					checkpoint->scratch[j] = rad_checkpoint_value(checkpoint, tape->args[op->first_input + j], start);
+				}
+				values[i - start] = op->custom_eval(checkpoint->scratch, partials + op->first_input - first_arg);
+				break;
+			default:
+				break;
+		}
+		if(checkpoint->external[i] != RAD_NOT_EXTERNAL){
+			checkpoint->ext_values[checkpoint->external[i]] = values[i - start];
+		}
+	}
+}
+
+//Propagates the adjoints of the instructions start to end - 1, whose values are in the segment buffer
+static void rad_checkpoint_reverse(rad_checkpoint *checkpoint, unsigned int start, unsigned int end, double *derivatives){
+	rad_tape *tape;
+	rad_tape_op *op;
+	double *values;
+	double *partials;
+	double deriv;
+	double x;
+	double y;
+	unsigned int first_arg;
+	unsigned int i;
+	unsigned int j;
+
+	tape = checkpoint->tape;
+	values = checkpoint->values;
+	partials = checkpoint->partials;
+	rad_checkpoint_segment_args(tape, start, end, &first_arg);
+	for(i = end; i-- > start;){
+		op = tape->ops + i;
+		deriv = checkpoint->adjoints[i - start];
+		switch(op->operation){
+			case INPUT:
+				derivatives[op->input_id] += deriv;
+				break;
+			case ADD:
+				*rad_checkpoint_adjoint(checkpoint, op->operand0, start) += deriv;
+				*rad_checkpoint_adjoint(checkpoint, op->operand1, start) += deriv;
+				break;
+			case SUBTRACT:
+				*rad_checkpoint_adjoint(checkpoint, op->operand0, start) += deriv;
+				*rad_checkpoint_adjoint(checkpoint, op->operand1, start) -= deriv;
+				break;
+			case MULTIPLY:
+				x = rad_checkpoint_value(checkpoint, op->operand0, start);
+				y = rad_checkpoint_value(checkpoint, op->operand1, start);
+				*rad_checkpoint_adjoint(checkpoint, op->operand0, start) += deriv*y;
+				*rad_checkpoint_adjoint(checkpoint, op->operand1, start) += deriv*x;
+				break;
+			case DIVIDE:
+				x = rad_checkpoint_value(checkpoint, op->operand0, start);
+				y = rad_checkpoint_value(checkpoint, op->operand1, start);
+				*rad_checkpoint_adjoint(checkpoint, op->operand0, start) += deriv/y;
+				*rad_checkpoint_adjoint(checkpoint, op->operand1, start) += -deriv*x/(y*y);
+				break;
+			case POW:
+				x = rad_checkpoint_value(checkpoint, op->operand0, start);
+				y = rad_checkpoint_value(checkpoint, op->operand1, start);
+				*rad_checkpoint_adjoint(checkpoint, op->operand0, start) += deriv*rad_pow_deriv0(x, y);
+				*rad_checkpoint_adjoint(checkpoint, op->operand1, start) += deriv*rad_pow_deriv1(x, values[i - start]);
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				x = rad_checkpoint_value(checkpoint, op->operand0, start);
+				*rad_checkpoint_adjoint(checkpoint, op->operand0, start) += deriv*rad_unary_deriv(op->operation, x, values[i - start]);
+				break;
+			case CUSTOM:
+				for(j = 0; j < op->num_inputs; j++){
+					*rad_checkpoint_adjoint(checkpoint, tape->args[op->first_input + j], start) += deriv*partials[op->first_input - first_arg + j];
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+//Like rad_tape_backward, but each segment is computed once going forward and once more before its reverse sweep,
+//except the last, whose values are still in the buffer
+double rad_checkpoint_backward(rad_checkpoint *checkpoint, double *inputs, double *derivatives){
+	rad_tape *tape;
+	unsigned int num_ops;
+	unsigned int start;
+	unsigned int end;
+	unsigned int i;
+	double output;
+
+	tape = checkpoint->tape;
+	num_ops = tape->output + 1;
+	for(start = 0; num_ops - start > checkpoint->segment_length; start += checkpoint->segment_length){
+		rad_checkpoint_forward(checkpoint, inputs, start, start + checkpoint->segment_length);
+	}
+	end = num_ops;
+	rad_checkpoint_forward(checkpoint, inputs, start, end);
+	output = checkpoint->values[tape->output - start];
+
+	memset(checkpoint->ext_adjoints, 0, sizeof(double)*checkpoint->num_external);
+	while(end > 0){
+		if(end != num_ops){
+			rad_checkpoint_forward(checkpoint, inputs, start, end);
+		}
+		for(i = start; i < end; i++){
+			if(checkpoint->external[i] != RAD_NOT_EXTERNAL){
+				checkpoint->adjoints[i - start] = checkpoint->ext_adjoints[checkpoint->external[i]];
+			} else {
+				checkpoint->adjoints[i - start] = 0;
+			}
+		}
+		if(end == num_ops){
+			checkpoint->adjoints[tape->output - start] = 1;
+		}
+		rad_checkpoint_reverse(checkpoint, start, end, derivatives);
+		end = start;
+		start = end > checkpoint->segment_length ? end - checkpoint->segment_length : 0;
+	}
+
+	return output;
+}
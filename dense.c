@@ -0,0 +1,138 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+//The weights of a dense layer are a row-major num_outputs by (num_inputs + 1) block with the bias last in each row.
+//The forward kernels compute four rows at a time so each input is loaded once for them, and the reverse kernel sweeps
+//every row over one block of inputs at a time so the inputs and their adjoints stay in cache.
+#define RAD_DENSE_BLOCK 512
+
+//Computes the outputs of a dense layer from its input_values. The terms are added in input order, then the bias,
+//which gives the same result as the equivalent graph of scalar nodes.
+void rad_dense_eval(rad_func *func, const double *weights){
+	const double *x;
+	const double *w0;
+	const double *w1;
+	const double *w2;
+	const double *w3;
+	double *y;
+	double a0;
+	double a1;
+	double a2;
+	double a3;
+	unsigned int stride;
+	unsigned int o;
+	unsigned int i;
+
+	x = func->input_values;
+	y = func->output_values;
+	stride = func->num_inputs + 1;
+	for(o = 0; o + 4 <= func->num_outputs; o += 4){
+		w0 = weights + (size_t) o*stride;
+		w1 = w0 + stride;
+		w2 = w1 + stride;
+		w3 = w2 + stride;
+		a0 = 0;
+		a1 = 0;
+		a2 = 0;
+		a3 = 0;
+		for(i = 0; i < func->num_inputs; i++){
+			a0 += x[i]*w0[i];
+			a1 += x[i]*w1[i];
+			a2 += x[i]*w2[i];
+			a3 += x[i]*w3[i];
+		}
+		y[o] = a0 + w0[func->num_inputs];
+		y[o + 1] = a1 + w1[func->num_inputs];
+		y[o + 2] = a2 + w2[func->num_inputs];
+		y[o + 3] = a3 + w3[func->num_inputs];
+	}
+	for(; o < func->num_outputs; o++){
+		w0 = weights + (size_t) o*stride;
+		a0 = 0;
+		for(i = 0; i < func->num_inputs; i++){
+			a0 += x[i]*w0[i];
+		}
+		y[o] = a0 + w0[func->num_inputs];
+	}
+}
+
+//Computes the tangents of the outputs of a dense layer into the derivatives following its output values, from the
+//tangents of its inputs in input_derivatives. The tangents of the weights are read from weight_tangents, or if it is
+//NULL, the weight with input id input_id has tangent one and the others zero.
+void rad_dense_tangent(rad_func *func, const double *weights, const double *weight_tangents, unsigned int input_id){
+	const double *x;
+	const double *dx;
+	const double *w;
+	const double *dw;
+	double *dy;
+	unsigned int stride;
+	unsigned int index;
+	unsigned int o;
+	unsigned int i;
+
+	x = func->input_values;
+	dx = func->input_derivatives;
+	dy = func->output_values + func->num_outputs;
+	stride = func->num_inputs + 1;
+	for(o = 0; o < func->num_outputs; o++){
+		w = weights + (size_t) o*stride;
+		dy[o] = 0;
+		if(weight_tangents != NULL){
+			dw = weight_tangents + (size_t) o*stride;
+			for(i = 0; i < func->num_inputs; i++){
+				dy[o] += w[i]*dx[i] + x[i]*dw[i];
+			}
+			dy[o] += dw[func->num_inputs];
+		} else {
+			for(i = 0; i < func->num_inputs; i++){
+				dy[o] += w[i]*dx[i];
+			}
+		}
+	}
+
+	if(weight_tangents == NULL && input_id >= func->weight_base && input_id - func->weight_base < (size_t) func->num_outputs*stride){
+		index = input_id - func->weight_base;
+		o = index/stride;
+		i = index%stride;
+		dy[o] += i < func->num_inputs ? x[i] : 1;
+	}
+}
+
+//Adds the gradient of the outputs weighted by their adjoints to weight_derivs, at the same offsets as the weights,
+//and to the input_derivatives of the layer
+void rad_dense_backward(rad_func *func, const double *weights, double *weight_derivs){
+	const double *x;
+	const double *adjoints;
+	const double *w;
+	double *dx;
+	double *dw;
+	double g;
+	unsigned int stride;
+	unsigned int start;
+	unsigned int end;
+	unsigned int o;
+	unsigned int i;
+
+	x = func->input_values;
+	dx = func->input_derivatives;
+	adjoints = func->output_values + func->num_outputs;
+	stride = func->num_inputs + 1;
+	for(start = 0; start < func->num_inputs; start += RAD_DENSE_BLOCK){
+		end = func->num_inputs - start > RAD_DENSE_BLOCK ? start + RAD_DENSE_BLOCK : func->num_inputs;
+		for(o = 0; o < func->num_outputs; o++){
+			g = adjoints[o];
+			w = weights + (size_t) o*stride;
+			dw = weight_derivs + (size_t) o*stride;
+			for(i = start; i < end; i++){
+				dw[i] += g*x[i];
+				dx[i] += g*w[i];
+			}
+		}
+	}
+	for(o = 0; o < func->num_outputs; o++){
+		weight_derivs[(size_t) o*stride + func->num_inputs] += adjoints[o];
+	}
+}
@@ -0,0 +1,338 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+static rad_custom_entry *rad_custom_entries = NULL;
+static unsigned int rad_num_custom_entries = 0;
+
+//Returns the registry entry of custom_eval, adding an empty one if it has none
+static rad_custom_entry *rad_custom_entry_get(double (*custom_eval)(double *, double *)){
+	rad_custom_entry *entry;
+	unsigned int i;
+
+	for(i = 0; i < rad_num_custom_entries; i++){
+		if(rad_custom_entries[i].custom_eval == custom_eval){
+			return rad_custom_entries + i;
+		}
+	}
+	rad_custom_entries = realloc(rad_custom_entries, sizeof(rad_custom_entry)*(rad_num_custom_entries + 1));
+	entry = rad_custom_entries + rad_num_custom_entries;
+	rad_num_custom_entries++;
+	entry->custom_eval = custom_eval;
+	entry->name = NULL;
+	entry->batch_eval = NULL;
+	entry->batch_vjp = NULL;
+
+	return entry;
+}
+
+//Gives the symbol under which custom_eval is linked, so generated code can call it and saved graphs can find it again.
+//Registering a function again renames it.
+void rad_register_custom(double (*custom_eval)(double *, double *), const char *name){
+	rad_custom_entry *entry;
+
+	entry = rad_custom_entry_get(custom_eval);
+	free(entry->name);
+	entry->name = malloc(strlen(name) + 1);
+	strcpy(entry->name, name);
+}
+
+//Gives kernels which the batched evaluators call once per block of samples instead of calling custom_eval per sample.
+//inputs[j] points to the n values of input j. batch_eval writes the n outputs, and unless partials is NULL, writes the
+//partial derivative of output k by input j to partials[j][k]. batch_vjp may be NULL. Otherwise the reverse pass calls
+//it instead of reading partials, and it adds adjoints[k] times the partial of output k by input j to
+//input_adjoints[j][k], where input_adjoints[j] may be the same column for several j. Passing NULL for batch_eval
+//returns custom_eval to being called per sample.
+void rad_custom_batch(double (*custom_eval)(double *, double *), void (*batch_eval)(double **inputs, double *outputs, double **partials, unsigned int n), void (*batch_vjp)(double **inputs, double *outputs, double *adjoints, double **input_adjoints, unsigned int n)){
+	rad_custom_entry *entry;
+
+	entry = rad_custom_entry_get(custom_eval);
+	entry->batch_eval = batch_eval;
+	entry->batch_vjp = batch_eval != NULL ? batch_vjp : NULL;
+}
+
+//Returns the registry entry of custom_eval, or NULL if nothing was registered for it
+const rad_custom_entry *rad_custom_lookup(double (*custom_eval)(double *, double *)){
+	unsigned int i;
+
+	for(i = 0; i < rad_num_custom_entries; i++){
+		if(rad_custom_entries[i].custom_eval == custom_eval){
+			return rad_custom_entries + i;
+		}
+	}
+
+	return NULL;
+}
+
+const char *rad_custom_name(double (*custom_eval)(double *, double *)){
+	const rad_custom_entry *entry;
+
+	entry = rad_custom_lookup(custom_eval);
+	if(entry == NULL){
+		return NULL;
+	}
+
+	return entry->name;
+}
+
+//The inverse of rad_custom_name, used to resolve custom functions in saved graphs
+double (*rad_custom_function(const char *name))(double *, double *){
+	unsigned int i;
+
+	for(i = 0; i < rad_num_custom_entries; i++){
+		if(rad_custom_entries[i].name != NULL && !strcmp(rad_custom_entries[i].name, name)){
+			return rad_custom_entries[i].custom_eval;
+		}
+	}
+
+	return NULL;
+}
+
+//Writes the C expression for a slot into name: a local for computed slots and a literal for constants
+static void rad_emit_name(rad_tape *tape, unsigned int slot, char *name){
+	double value;
+
+	if(tape->ops[slot].operation != CONSTANT){
+		sprintf(name, "v%u", slot);
+		return;
+	}
+
+	value = tape->ops[slot].const_value;
+	if(isnan(value)){
+		strcpy(name, "NAN");
+	} else if(isinf(value)){
+		strcpy(name, value > 0 ? "HUGE_VAL" : "(-HUGE_VAL)");
+	} else {
+		sprintf(name, value < 0 ? "(%.17g" : "%.17g", value);
+		//Keep integral constants from turning divisions into integer divisions
+		if(strpbrk(name, ".e") == NULL){
+			strcat(name, ".0");
+		}
+		if(value < 0){
+			strcat(name, ")");
+		}
+	}
+}
+
+//Adds the adjoint contribution expr to slot, unless the slot is a constant
+static void rad_emit_adjoint(FILE *file, rad_tape *tape, unsigned int slot, const char *sign, const char *expr){
+	if(tape->ops[slot].operation != CONSTANT){
+		fprintf(file, "\ta%u %s= %s;\n", slot, sign, expr);
+	}
+}
+
+static void rad_emit_forward(FILE *file, rad_tape *tape, unsigned int i){
+	rad_tape_op *op;
+	char x[64];
+	char y[64];
+	unsigned int j;
+
+	op = tape->ops + i;
+	rad_emit_name(tape, op->operand0, x);
+	rad_emit_name(tape, op->operand1, y);
+	switch(op->operation){
+		case INPUT:
+			fprintf(file, "\tv%u = inputs[%u];\n", i, op->input_id);
+			break;
+		case ADD:
+			fprintf(file, "\tv%u = %s + %s;\n", i, x, y);
+			break;
+		case SUBTRACT:
+			fprintf(file, "\tv%u = %s - %s;\n", i, x, y);
+			break;
+		case MULTIPLY:
+			fprintf(file, "\tv%u = %s*%s;\n", i, x, y);
+			break;
+		case DIVIDE:
+			fprintf(file, "\tv%u = %s/%s;\n", i, x, y);
+			break;
+		case POW:
+			fprintf(file, "\tv%u = pow(%s, %s);\n", i, x, y);
+			break;
+		case EXP:
+			fprintf(file, "\tv%u = exp(%s);\n", i, x);
+			break;
+		case LOG:
+			fprintf(file, "\tv%u = log(%s);\n", i, x);
+			break;
+		case SIN:
+			fprintf(file, "\tv%u = sin(%s);\n", i, x);
+			break;
+		case COS:
+			fprintf(file, "\tv%u = cos(%s);\n", i, x);
+			break;
+		case TANH:
+			fprintf(file, "\tv%u = tanh(%s);\n", i, x);
+			break;
+		case SQRT:
+			fprintf(file, "\tv%u = sqrt(%s);\n", i, x);
+			break;
+		case SIGMOID:
+			fprintf(file, "\tv%u = 1/(1 + exp(-%s));\n", i, x);
+			break;
+		case CUSTOM:
+			for(j = 0; j < op->num_inputs; j++){
+				rad_emit_name(tape, tape->args[op->first_input + j], x);
+				fprintf(file, "\tin%u[%u] = %s;\n", i, j, x);
+			}
+			fprintf(file, "\tv%u = %s(in%u, p%u);\n", i, rad_custom_name(op->custom_eval), i, i);
+			break;
+		default:
+			break;
+	}
+}
+
+static void rad_emit_backward(FILE *file, rad_tape *tape, unsigned int i){
+	rad_tape_op *op;
+	char x[64];
+	char y[64];
+	char expr[256];
+	unsigned int j;
+
+	op = tape->ops + i;
+	rad_emit_name(tape, op->operand0, x);
+	rad_emit_name(tape, op->operand1, y);
+	switch(op->operation){
+		case INPUT:
+			fprintf(file, "\tderivatives[%u] += a%u;\n", op->input_id, i);
+			break;
+		case ADD:
+		case SUBTRACT:
+			sprintf(expr, "a%u", i);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			rad_emit_adjoint(file, tape, op->operand1, op->operation == ADD ? "+" : "-", expr);
+			break;
+		case MULTIPLY:
+			sprintf(expr, "a%u*%s", i, y);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			sprintf(expr, "a%u*%s", i, x);
+			rad_emit_adjoint(file, tape, op->operand1, "+", expr);
+			break;
+		case DIVIDE:
+			sprintf(expr, "a%u/%s", i, y);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			sprintf(expr, "a%u*%s/(%s*%s)", i, x, y, y);
+			rad_emit_adjoint(file, tape, op->operand1, "-", expr);
+			break;
+		case POW:
+			sprintf(expr, "a%u*%s*pow(%s, %s - 1)", i, y, x, y);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			sprintf(expr, "(%s == 0 ? 0 : a%u*v%u*log(%s))", x, i, i, x);
+			rad_emit_adjoint(file, tape, op->operand1, "+", expr);
+			break;
+		case EXP:
+			sprintf(expr, "a%u*v%u", i, i);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			break;
+		case LOG:
+			sprintf(expr, "a%u/%s", i, x);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			break;
+		case SIN:
+			sprintf(expr, "a%u*cos(%s)", i, x);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			break;
+		case COS:
+			sprintf(expr, "a%u*sin(%s)", i, x);
+			rad_emit_adjoint(file, tape, op->operand0, "-", expr);
+			break;
+		case TANH:
+			sprintf(expr, "a%u*(1 - v%u*v%u)", i, i, i);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			break;
+		case SQRT:
+			sprintf(expr, "a%u*0.5/v%u", i, i);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			break;
+		case SIGMOID:
+			sprintf(expr, "a%u*v%u*(1 - v%u)", i, i, i);
+			rad_emit_adjoint(file, tape, op->operand0, "+", expr);
+			break;
+		case CUSTOM:
+			for(j = 0; j < op->num_inputs; j++){
+				sprintf(expr, "a%u*p%u[%u]", i, i, j);
+				rad_emit_adjoint(file, tape, tape->args[op->first_input + j], "+", expr);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+//Writes a C function named name with the signature double name(const double *inputs, double *derivatives). It returns the value
+//of func at inputs, and unless derivatives is NULL, adds the gradient to derivatives like rad_backward_diff. Every custom function
+//in func must have been given a symbol with rad_register_custom, otherwise nothing is written and false is returned.
+bool rad_emit_c(/*not consumed*/rad_func *func, FILE *file, const char *name){
+	rad_tape *tape;
+	rad_tape_op *op;
+	const char *custom_name;
+	char output[64];
+	bool declared = false;
+	unsigned int i;
+	unsigned int j;
+
+	tape = rad_compile(func);
+	if(tape == NULL){
+		return false;
+	}
+	for(i = 0; i <= tape->output; i++){
+		op = tape->ops + i;
+		if(op->operation == CUSTOM && rad_custom_name(op->custom_eval) == NULL){
+			rad_tape_free(tape);
+			return false;
+		}
+	}
+
+	fprintf(file, "#include <stddef.h>\n#include <math.h>\n");
+	for(i = 0; i <= tape->output; i++){
+		op = tape->ops + i;
+		if(op->operation != CUSTOM){
+			continue;
+		}
+		custom_name = rad_custom_name(op->custom_eval);
+		for(j = 0; j < i; j++){
+			if(tape->ops[j].operation == CUSTOM && rad_custom_name(tape->ops[j].custom_eval) == custom_name){
+				break;
+			}
+		}
+		if(j == i){
+			fprintf(file, "%sdouble %s(double *, double *);\n", declared ? "" : "\n", custom_name);
+			declared = true;
+		}
+	}
+
+	fprintf(file, "\ndouble %s(const double *inputs, double *derivatives){\n", name);
+	for(i = 0; i <= tape->output; i++){
+		op = tape->ops + i;
+		if(op->operation == CONSTANT){
+			continue;
+		}
+		fprintf(file, "\tdouble v%u;\n\tdouble a%u = 0;\n", i, i);
+		//Arrays of zero length are not valid C, so custom functions without inputs get one unused element
+		if(op->operation == CUSTOM){
+			fprintf(file, "\tdouble in%u[%u];\n\tdouble p%u[%u];\n", i, op->num_inputs ? op->num_inputs : 1, i, op->num_inputs ? op->num_inputs : 1);
+		}
+	}
+	fprintf(file, "\n");
+
+	for(i = 0; i <= tape->output; i++){
+		rad_emit_forward(file, tape, i);
+	}
+	rad_emit_name(tape, tape->output, output);
+	fprintf(file, "\tif(derivatives == NULL){\n\t\treturn %s;\n\t}\n\n", output);
+
+	if(tape->ops[tape->output].operation != CONSTANT){
+		fprintf(file, "\ta%u = 1;\n", tape->output);
+	}
+	for(i = tape->output + 1; i-- > 0;){
+		rad_emit_backward(file, tape, i);
+	}
+	fprintf(file, "\n\treturn %s;\n}\n", output);
+	rad_tape_free(tape);
+
+	return true;
+}
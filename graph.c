@@ -0,0 +1,237 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+static unsigned int rad_node_hash(rad_func *key){
+	uint64_t x;
+
+	x = (uintptr_t) key;
+	x ^= x>>33;
+	x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x>>33;
+
+	return x;
+}
+
+void rad_node_map_init(rad_node_map *map){
+	map->capacity = 16;
+	map->size = 0;
+	map->keys = calloc(map->capacity, sizeof(rad_func *));
+	map->values = malloc(sizeof(unsigned int)*map->capacity);
+}
+
+void rad_node_map_free(rad_node_map *map){
+	free(map->keys);
+	free(map->values);
+}
+
+bool rad_node_map_get(rad_node_map *map, rad_func *key, unsigned int *value){
+	unsigned int i;
+
+	i = rad_node_hash(key)&(map->capacity - 1);
+	while(map->keys[i] != NULL){
+		if(map->keys[i] == key){
+			if(value != NULL){
+				*value = map->values[i];
+			}
+			return true;
+		}
+		i = (i + 1)&(map->capacity - 1);
+	}
+
+	return false;
+}
+
+static void rad_node_map_grow(rad_node_map *map){
+	rad_func **old_keys;
+	unsigned int *old_values;
+	unsigned int old_capacity;
+	unsigned int i;
+
+	old_keys = map->keys;
+	old_values = map->values;
+	old_capacity = map->capacity;
+
+	map->capacity *= 2;
+	map->size = 0;
+	map->keys = calloc(map->capacity, sizeof(rad_func *));
+	map->values = malloc(sizeof(unsigned int)*map->capacity);
+	for(i = 0; i < old_capacity; i++){
+		if(old_keys[i] != NULL){
+			rad_node_map_set(map, old_keys[i], old_values[i]);
+		}
+	}
+
+	free(old_keys);
+	free(old_values);
+}
+
+void rad_node_map_set(rad_node_map *map, rad_func *key, unsigned int value){
+	unsigned int i;
+
+	if(2*(map->size + 1) > map->capacity){
+		rad_node_map_grow(map);
+	}
+
+	i = rad_node_hash(key)&(map->capacity - 1);
+	while(map->keys[i] != NULL && map->keys[i] != key){
+		i = (i + 1)&(map->capacity - 1);
+	}
+	if(map->keys[i] == NULL){
+		map->keys[i] = key;
+		map->size++;
+	}
+	map->values[i] = value;
+}
+
+unsigned int rad_num_children(rad_func *func){
+	switch(func->operation){
+		case ADD:
+		case SUBTRACT:
+		case MULTIPLY:
+		case DIVIDE:
+		case POW:
+			return 2;
+		case EXP:
+		case LOG:
+		case SIN:
+		case COS:
+		case TANH:
+		case SQRT:
+		case SIGMOID:
+		case DENSE_OUTPUT:
+			return 1;
+		case COMPOSITION:
+		case CUSTOM:
+		case DENSE:
+			return func->num_inputs;
+		default:
+			return 0;
+	}
+}
+
+rad_func *rad_child(rad_func *func, unsigned int index){
+	return *rad_child_pointer(func, index);
+}
+
+rad_func **rad_child_pointer(rad_func *func, unsigned int index){
+	switch(func->operation){
+		case ADD:
+		case SUBTRACT:
+		case MULTIPLY:
+		case DIVIDE:
+		case POW:
+		case EXP:
+		case LOG:
+		case SIN:
+		case COS:
+		case TANH:
+		case SQRT:
+		case SIGMOID:
+		case DENSE_OUTPUT:
+			if(index == 0){
+				return &func->operand0;
+			} else {
+				return &func->operand1;
+			}
+		case COMPOSITION:
+		case CUSTOM:
+		case DENSE:
+			return func->inputs + index;
+		default:
+			return NULL;
+	}
+}
+
+typedef struct rad_order_frame rad_order_frame;
+
+struct rad_order_frame{
+	rad_func *func;
+	unsigned int next_child;
+};
+
+//Compositions depend on the function they compose as an extra last child, when the graph order enters compositions
+static unsigned int rad_order_num_children(rad_func *func, bool compositions){
+	if(compositions && func->operation == COMPOSITION){
+		return func->num_inputs + 1;
+	}
+	return rad_num_children(func);
+}
+
+static rad_func *rad_order_child(rad_func *func, unsigned int index, bool compositions){
+	if(compositions && func->operation == COMPOSITION && index == func->num_inputs){
+		return func->func;
+	}
+	return rad_child(func, index);
+}
+
+static rad_func **rad_order(rad_func *func, unsigned int *num_nodes, rad_node_map *map, bool compositions){
+	rad_node_map visited;
+	rad_order_frame *stack;
+	rad_order_frame *frame;
+	rad_func **output;
+	rad_func *child;
+	unsigned int stack_size;
+	unsigned int stack_capacity = 16;
+	unsigned int output_capacity = 16;
+
+	if(map == NULL){
+		rad_node_map_init(&visited);
+		map = &visited;
+	}
+
+	output = malloc(sizeof(rad_func *)*output_capacity);
+	*num_nodes = 0;
+	stack = malloc(sizeof(rad_order_frame)*stack_capacity);
+	stack[0].func = func;
+	stack[0].next_child = 0;
+	stack_size = 1;
+
+	while(stack_size){
+		frame = stack + stack_size - 1;
+		if(frame->next_child < rad_order_num_children(frame->func, compositions)){
+			child = rad_order_child(frame->func, frame->next_child, compositions);
+			frame->next_child++;
+			if(!rad_node_map_get(map, child, NULL)){
+				if(stack_size == stack_capacity){
+					stack_capacity *= 2;
+					stack = realloc(stack, sizeof(rad_order_frame)*stack_capacity);
+				}
+				stack[stack_size].func = child;
+				stack[stack_size].next_child = 0;
+				stack_size++;
+			}
+			continue;
+		}
+
+		if(*num_nodes == output_capacity){
+			output_capacity *= 2;
+			output = realloc(output, sizeof(rad_func *)*output_capacity);
+		}
+		rad_node_map_set(map, frame->func, *num_nodes);
+		output[*num_nodes] = frame->func;
+		++*num_nodes;
+		stack_size--;
+	}
+
+	free(stack);
+	if(map == &visited){
+		rad_node_map_free(&visited);
+	}
+
+	return output;
+}
+
+//Returns the distinct nodes reachable from func, children before parents. The functions inside compositions are not entered.
+//If map is not NULL, it must be initialized and is filled with the position of each node in the returned array.
+rad_func **rad_topological_order(rad_func *func, unsigned int *num_nodes, rad_node_map *map){
+	return rad_order(func, num_nodes, map, false);
+}
+
+//Like rad_topological_order, but also orders the nodes of composed functions, each before the compositions using it
+rad_func **rad_graph_order(rad_func *func, unsigned int *num_nodes, rad_node_map *map){
+	return rad_order(func, num_nodes, map, true);
+}
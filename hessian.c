@@ -0,0 +1,350 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+//RAD has no second derivatives for custom functions, so the change in their partials along the tangent is taken by
+//a central difference. The partials of custom functions should therefore be smooth for Hessians to be accurate.
+static void rad_custom_partial_tangents(rad_ctx *ctx){
+	rad_tape *tape;
+	rad_tape_op *op;
+	double *scratch;
+	double *partial_tangents;
+	double input_norm;
+	double tangent_norm;
+	double step;
+	unsigned int slot;
+	unsigned int i;
+	unsigned int j;
+
+	tape = ctx->tape;
+	scratch = ctx->scratch;
+	for(i = 0; i < tape->num_ops; i++){
+		op = tape->ops + i;
+		if(op->operation != CUSTOM){
+			continue;
+		}
+		partial_tangents = ctx->partial_tangents + op->first_input;
+		input_norm = 0;
+		tangent_norm = 0;
+		for(j = 0; j < op->num_inputs; j++){
+			slot = tape->args[op->first_input + j];
+			input_norm = fmax(input_norm, fabs(ctx->values[slot]));
+			tangent_norm = fmax(tangent_norm, fabs(ctx->tangents[slot]));
+		}
+		if(tangent_norm == 0){
+			memset(partial_tangents, 0, sizeof(double)*op->num_inputs);
+			continue;
+		}
+
+		step = cbrt(DBL_EPSILON)*(1 + input_norm)/tangent_norm;
+		for(j = 0; j < op->num_inputs; j++){
+			slot = tape->args[op->first_input + j];
+			scratch[j] = ctx->values[slot] + step*ctx->tangents[slot];
+		}
+		op->custom_eval(scratch, scratch + op->num_inputs);
+		memcpy(partial_tangents, scratch + op->num_inputs, sizeof(double)*op->num_inputs);
+		for(j = 0; j < op->num_inputs; j++){
+			slot = tape->args[op->first_input + j];
+			scratch[j] = ctx->values[slot] - step*ctx->tangents[slot];
+		}
+		op->custom_eval(scratch, scratch + op->num_inputs);
+		for(j = 0; j < op->num_inputs; j++){
+			partial_tangents[j] = (partial_tangents[j] - scratch[op->num_inputs + j])/(2*step);
+		}
+	}
+}
+
+//Adds the product of the Hessian with v to out by differentiating the reverse sweep along v (forward over reverse)
+double rad_hvp_ctx(rad_ctx *ctx, double *inputs, double *v, double *out){
+	rad_tape *tape;
+	rad_tape_op *op;
+	double *values;
+	double *tangents;
+	double *adjoints;
+	double *adjoint_tangents;
+	double *partials;
+	double *partial_tangents;
+	double output;
+	double deriv;
+	double deriv_tangent;
+	double value0;
+	double value1;
+	double tangent0;
+	double tangent1;
+	double d0;
+	double d1;
+	double d00;
+	double d01;
+	double d11;
+	unsigned int slot;
+	unsigned int i;
+	unsigned int j;
+
+	tape = ctx->tape;
+	output = rad_forward_grad_vec_ctx(ctx, inputs, v, 1, &deriv);
+	if(ctx->adjoint_tangents == NULL){
+		ctx->adjoint_tangents = malloc(sizeof(double)*tape->num_ops);
+		ctx->partial_tangents = malloc(sizeof(double)*tape->num_args);
+	}
+	rad_custom_partial_tangents(ctx);
+
+	values = ctx->values;
+	tangents = ctx->tangents;
+	adjoints = ctx->adjoints;
+	adjoint_tangents = ctx->adjoint_tangents;
+	memset(adjoints, 0, sizeof(double)*(tape->output + 1));
+	memset(adjoint_tangents, 0, sizeof(double)*(tape->output + 1));
+	adjoints[tape->output] = 1;
+
+	for(i = tape->output + 1; i-- > 0;){
+		op = tape->ops + i;
+		deriv = adjoints[i];
+		deriv_tangent = adjoint_tangents[i];
+		value0 = values[op->operand0];
+		value1 = values[op->operand1];
+		tangent0 = tangents[op->operand0];
+		tangent1 = tangents[op->operand1];
+		switch(op->operation){
+			case INPUT:
+				out[op->input_id] += deriv_tangent;
+				break;
+			case ADD:
+				adjoints[op->operand0] += deriv;
+				adjoints[op->operand1] += deriv;
+				adjoint_tangents[op->operand0] += deriv_tangent;
+				adjoint_tangents[op->operand1] += deriv_tangent;
+				break;
+			case SUBTRACT:
+				adjoints[op->operand0] += deriv;
+				adjoints[op->operand1] -= deriv;
+				adjoint_tangents[op->operand0] += deriv_tangent;
+				adjoint_tangents[op->operand1] -= deriv_tangent;
+				break;
+			case MULTIPLY:
+				adjoints[op->operand0] += deriv*value1;
+				adjoints[op->operand1] += deriv*value0;
+				adjoint_tangents[op->operand0] += deriv_tangent*value1 + deriv*tangent1;
+				adjoint_tangents[op->operand1] += deriv_tangent*value0 + deriv*tangent0;
+				break;
+			case DIVIDE:
+				d0 = 1/value1;
+				d1 = -value0/(value1*value1);
+				d01 = -1/(value1*value1);
+				d11 = 2*value0/(value1*value1*value1);
+				adjoints[op->operand0] += deriv*d0;
+				adjoints[op->operand1] += deriv*d1;
+				adjoint_tangents[op->operand0] += deriv_tangent*d0 + deriv*d01*tangent1;
+				adjoint_tangents[op->operand1] += deriv_tangent*d1 + deriv*(d01*tangent0 + d11*tangent1);
+				break;
+			case POW:
+				d0 = rad_pow_deriv0(value0, value1);
+				d1 = rad_pow_deriv1(value0, values[i]);
+				d00 = rad_pow_deriv00(value0, value1);
+				d01 = rad_pow_deriv01(value0, value1);
+				d11 = rad_pow_deriv11(value0, values[i]);
+				adjoints[op->operand0] += deriv*d0;
+				adjoints[op->operand1] += deriv*d1;
+				adjoint_tangents[op->operand0] += deriv_tangent*d0 + deriv*(d00*tangent0 + d01*tangent1);
+				adjoint_tangents[op->operand1] += deriv_tangent*d1 + deriv*(d01*tangent0 + d11*tangent1);
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				d0 = rad_unary_deriv(op->operation, value0, values[i]);
+				d00 = rad_unary_deriv2(op->operation, value0, values[i]);
+				adjoints[op->operand0] += deriv*d0;
+				adjoint_tangents[op->operand0] += deriv_tangent*d0 + deriv*d00*tangent0;
+				break;
+			case CUSTOM:
+				partials = ctx->partials + op->first_input;
+				partial_tangents = ctx->partial_tangents + op->first_input;
+				for(j = 0; j < op->num_inputs; j++){
+					slot = tape->args[op->first_input + j];
+					adjoints[slot] += deriv*partials[j];
+					adjoint_tangents[slot] += deriv_tangent*partials[j] + deriv*partial_tangents[j];
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	return output;
+}
+
+double rad_tape_hvp(rad_tape *tape, double *inputs, double *v, double *out){
+	return rad_hvp_ctx(rad_tape_ctx(tape), inputs, v, out);
+}
+
+double rad_hvp(rad_func *func, double *inputs, double *v, double *out){
+	rad_tape *tape;
+	double output;
+
+	tape = rad_compile(func);
+	if(tape == NULL){
+		return NAN;
+	}
+	output = rad_tape_hvp(tape, inputs, v, out);
+	rad_tape_free(tape);
+
+	return output;
+}
+
+//Marks the inputs which reach an operand that the function is nonlinear in. The function is affine in every other
+//input with a constant coefficient, so their rows and columns of the Hessian are zero.
+static void rad_nonlinear_inputs(rad_tape *tape, bool *nonlinear){
+	rad_tape_op *op;
+	bool *varying;
+	bool *needed;
+	unsigned int i;
+	unsigned int j;
+
+	varying = malloc(sizeof(bool)*tape->num_ops);
+	needed = calloc(tape->num_ops, sizeof(bool));
+	for(i = 0; i < tape->num_ops; i++){
+		op = tape->ops + i;
+		switch(op->operation){
+			case CONSTANT:
+				varying[i] = false;
+				break;
+			case INPUT:
+				varying[i] = true;
+				break;
+			case ADD:
+			case SUBTRACT:
+				varying[i] = varying[op->operand0] || varying[op->operand1];
+				break;
+			case MULTIPLY:
+				varying[i] = varying[op->operand0] || varying[op->operand1];
+				if(varying[op->operand0] && varying[op->operand1]){
+					needed[op->operand0] = true;
+					needed[op->operand1] = true;
+				}
+				break;
+			case DIVIDE:
+			case POW:
+				varying[i] = varying[op->operand0] || varying[op->operand1];
+				if(varying[op->operand1]){
+					needed[op->operand0] = true;
+					needed[op->operand1] = true;
+				} else if(op->operation == POW){
+					needed[op->operand0] = true;
+				}
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				varying[i] = varying[op->operand0];
+				needed[op->operand0] = true;
+				break;
+			case CUSTOM:
+				varying[i] = false;
+				for(j = 0; j < op->num_inputs; j++){
+					varying[i] = varying[i] || varying[tape->args[op->first_input + j]];
+					needed[tape->args[op->first_input + j]] = true;
+				}
+				break;
+			default:
+				varying[i] = false;
+				break;
+		}
+	}
+
+	memset(nonlinear, 0, sizeof(bool)*tape->num_inputs);
+	for(i = tape->num_ops; i-- > 0;){
+		op = tape->ops + i;
+		if(!needed[i] || !varying[i]){
+			continue;
+		}
+		switch(op->operation){
+			case INPUT:
+				nonlinear[op->input_id] = true;
+				break;
+			case ADD:
+			case SUBTRACT:
+			case MULTIPLY:
+			case DIVIDE:
+			case POW:
+				needed[op->operand0] = true;
+				needed[op->operand1] = true;
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				needed[op->operand0] = true;
+				break;
+			case CUSTOM:
+				for(j = 0; j < op->num_inputs; j++){
+					needed[tape->args[op->first_input + j]] = true;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	free(varying);
+	free(needed);
+}
+
+//Stores the Hessian in row-major order with one row and column per input id. Each row is one Hessian-vector product.
+//If sparse is true, the rows of inputs which the function is affine in are set to zero without being evaluated.
+void rad_tape_hessian(rad_tape *tape, double *inputs, double *hessian, bool sparse){
+	bool *nonlinear;
+	double *v;
+	unsigned int num_inputs;
+	unsigned int i;
+
+	num_inputs = tape->num_inputs;
+	nonlinear = malloc(sizeof(bool)*(num_inputs ? num_inputs : 1));
+	if(sparse){
+		rad_nonlinear_inputs(tape, nonlinear);
+	} else {
+		for(i = 0; i < num_inputs; i++){
+			nonlinear[i] = true;
+		}
+	}
+
+	v = calloc(num_inputs ? num_inputs : 1, sizeof(double));
+	memset(hessian, 0, sizeof(double)*num_inputs*num_inputs);
+	for(i = 0; i < num_inputs; i++){
+		if(!nonlinear[i]){
+			continue;
+		}
+		v[i] = 1;
+		rad_hvp_ctx(rad_tape_ctx(tape), inputs, v, hessian + i*num_inputs);
+		v[i] = 0;
+	}
+
+	free(v);
+	free(nonlinear);
+}
+
+bool rad_hessian(rad_func *func, double *inputs, double *hessian, bool sparse){
+	rad_tape *tape;
+
+	tape = rad_compile(func);
+	if(tape == NULL){
+		return false;
+	}
+	rad_tape_hessian(tape, inputs, hessian, sparse);
+	rad_tape_free(tape);
+
+	return true;
+}
@@ -0,0 +1,561 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+//Native code is generated for the System V x86-64 calling convention. Everywhere else rad_jit falls back to the tape interpreter.
+#if defined(__x86_64__) && !defined(_WIN32)
+#define RAD_JIT_X86_64
+#include <sys/mman.h>
+#endif
+
+//Generated code has the signature of rad_jit_entry and keeps its arguments in callee-saved registers:
+//rbx values, r12 adjoints, r13 partials, r14 inputs, r15 derivatives and rbp scratch.
+//There is no register allocation. Every instruction stores its result to values and the reverse sweep stores every
+//adjoint to adjoints, and operands are loaded back from memory. The only values reused from registers are the result
+//of the previous instruction in xmm0 and the adjoint written last in cached_xmm, so the code is bound by loads and
+//stores much like the interpreter, without its dispatch.
+typedef double (*rad_jit_entry)(double *inputs, double *derivatives, double *values, double *adjoints, double *partials, double *scratch);
+
+#ifdef RAD_JIT_X86_64
+
+enum rad_jit_reg{
+	RAX = 0,
+	RCX = 1,
+	RDX = 2,
+	RBX = 3,
+	RSP = 4,
+	RBP = 5,
+	RSI = 6,
+	RDI = 7,
+	R8 = 8,
+	R9 = 9,
+	R12 = 12,
+	R13 = 13,
+	R14 = 14,
+	R15 = 15
+};
+
+//Opcodes of the scalar double instructions, which all take the F2 0F prefix
+enum rad_jit_sse{
+	MOVSD_LOAD = 0x10,
+	MOVSD_STORE = 0x11,
+	SQRTSD = 0x51,
+	ADDSD = 0x58,
+	MULSD = 0x59,
+	SUBSD = 0x5C,
+	DIVSD = 0x5E
+};
+
+typedef struct rad_jit_buffer rad_jit_buffer;
+
+struct rad_jit_buffer{
+	unsigned char *code;
+	size_t size;
+	size_t capacity;
+};
+
+static void rad_jit_byte(rad_jit_buffer *buffer, unsigned char byte){
+	if(buffer->size == buffer->capacity){
+		buffer->capacity *= 2;
+		buffer->code = realloc(buffer->code, buffer->capacity);
+	}
+	buffer->code[buffer->size] = byte;
+	buffer->size++;
+}
+
+static void rad_jit_bytes(rad_jit_buffer *buffer, uint64_t value, unsigned int num_bytes){
+	unsigned int i;
+
+	for(i = 0; i < num_bytes; i++){
+		rad_jit_byte(buffer, value>>(8*i));
+	}
+}
+
+//ModRM byte, and SIB byte when needed, addressing [base + disp32]
+static void rad_jit_address(rad_jit_buffer *buffer, unsigned int reg, enum rad_jit_reg base, uint32_t disp){
+	rad_jit_byte(buffer, 0x80 | (reg&7)<<3 | (base&7));
+	if((base&7) == RSP){
+		rad_jit_byte(buffer, 0x24);
+	}
+	rad_jit_bytes(buffer, disp, 4);
+}
+
+//op xmm, [base + 8*slot], or movsd [base + 8*slot], xmm for MOVSD_STORE
+static void rad_jit_sse_mem(rad_jit_buffer *buffer, enum rad_jit_sse op, unsigned int xmm, enum rad_jit_reg base, unsigned int slot){
+	rad_jit_byte(buffer, 0xF2);
+	if(base >= 8){
+		rad_jit_byte(buffer, 0x41);
+	}
+	rad_jit_byte(buffer, 0x0F);
+	rad_jit_byte(buffer, op);
+	rad_jit_address(buffer, xmm, base, 8*slot);
+}
+
+static void rad_jit_sse_reg(rad_jit_buffer *buffer, enum rad_jit_sse op, unsigned int dst, unsigned int src){
+	rad_jit_byte(buffer, 0xF2);
+	rad_jit_byte(buffer, 0x0F);
+	rad_jit_byte(buffer, op);
+	rad_jit_byte(buffer, 0xC0 | dst<<3 | src);
+}
+
+static void rad_jit_mov_reg(rad_jit_buffer *buffer, enum rad_jit_reg dst, enum rad_jit_reg src){
+	rad_jit_byte(buffer, 0x48 | (src >= 8)<<2 | (dst >= 8));
+	rad_jit_byte(buffer, 0x89);
+	rad_jit_byte(buffer, 0xC0 | (src&7)<<3 | (dst&7));
+}
+
+static void rad_jit_mov_imm64(rad_jit_buffer *buffer, enum rad_jit_reg dst, uint64_t value){
+	rad_jit_byte(buffer, 0x48 | (dst >= 8));
+	rad_jit_byte(buffer, 0xB8 + (dst&7));
+	rad_jit_bytes(buffer, value, 8);
+}
+
+static void rad_jit_mov_imm32(rad_jit_buffer *buffer, enum rad_jit_reg dst, uint32_t value){
+	if(dst >= 8){
+		rad_jit_byte(buffer, 0x41);
+	}
+	rad_jit_byte(buffer, 0xB8 + (dst&7));
+	rad_jit_bytes(buffer, value, 4);
+}
+
+static void rad_jit_lea(rad_jit_buffer *buffer, enum rad_jit_reg dst, enum rad_jit_reg base, unsigned int slot){
+	rad_jit_byte(buffer, 0x48 | (dst >= 8)<<2 | (base >= 8));
+	rad_jit_byte(buffer, 0x8D);
+	rad_jit_address(buffer, dst, base, 8*slot);
+}
+
+static void rad_jit_push(rad_jit_buffer *buffer, enum rad_jit_reg reg){
+	if(reg >= 8){
+		rad_jit_byte(buffer, 0x41);
+	}
+	rad_jit_byte(buffer, 0x50 + (reg&7));
+}
+
+static void rad_jit_pop(rad_jit_buffer *buffer, enum rad_jit_reg reg){
+	if(reg >= 8){
+		rad_jit_byte(buffer, 0x41);
+	}
+	rad_jit_byte(buffer, 0x58 + (reg&7));
+}
+
+static uint64_t rad_jit_double_bits(double value){
+	uint64_t output;
+
+	memcpy(&output, &value, sizeof(double));
+
+	return output;
+}
+
+//Stores a double constant into [base + 8*slot] through rax
+static void rad_jit_store_const(rad_jit_buffer *buffer, enum rad_jit_reg base, unsigned int slot, double value){
+	rad_jit_mov_imm64(buffer, RAX, rad_jit_double_bits(value));
+	rad_jit_byte(buffer, 0x48 | (base >= 8));
+	rad_jit_byte(buffer, 0x89);
+	rad_jit_address(buffer, RAX, base, 8*slot);
+}
+
+//movq xmm, rax after loading a double constant into rax
+static void rad_jit_load_const(rad_jit_buffer *buffer, unsigned int xmm, double value){
+	rad_jit_mov_imm64(buffer, RAX, rad_jit_double_bits(value));
+	rad_jit_byte(buffer, 0x66);
+	rad_jit_byte(buffer, 0x48);
+	rad_jit_byte(buffer, 0x0F);
+	rad_jit_byte(buffer, 0x6E);
+	rad_jit_byte(buffer, 0xC0 | xmm<<3);
+}
+
+static void rad_jit_call(rad_jit_buffer *buffer, uintptr_t function){
+	rad_jit_mov_imm64(buffer, RAX, function);
+	rad_jit_byte(buffer, 0xFF);
+	rad_jit_byte(buffer, 0xD0);
+}
+
+static void rad_jit_pow_backward(double *values, double *adjoints, unsigned int slot, unsigned int operand0, unsigned int operand1){
+	adjoints[operand0] += adjoints[slot]*rad_pow_deriv0(values[operand0], values[operand1]);
+	adjoints[operand1] += adjoints[slot]*rad_pow_deriv1(values[operand0], values[slot]);
+}
+
+//State of the reverse sweep while generating it. The sweep order is known, so the first contribution to each adjoint is
+//stored directly instead of being added to a zeroed buffer. The adjoint written last is still held in cached_xmm.
+typedef struct rad_jit_sweep rad_jit_sweep;
+
+struct rad_jit_sweep{
+	bool *written;
+	unsigned int cached_slot;
+	unsigned int cached_xmm;
+};
+
+//Adds xmm to the adjoint of slot using xmm3, or subtracts it if subtract is true. Constants need no adjoint.
+static void rad_jit_accumulate(rad_jit_buffer *buffer, rad_tape *tape, rad_jit_sweep *sweep, unsigned int slot, unsigned int xmm, bool subtract){
+	sweep->cached_slot = tape->num_ops;
+	if(tape->ops[slot].operation == CONSTANT){
+		return;
+	}
+	sweep->cached_slot = slot;
+	sweep->cached_xmm = 3;
+	if(!sweep->written[slot]){
+		sweep->written[slot] = true;
+		if(!subtract){
+			rad_jit_sse_mem(buffer, MOVSD_STORE, xmm, R12, slot);
+			sweep->cached_xmm = xmm;
+			return;
+		}
+		rad_jit_load_const(buffer, 3, 0);
+	} else {
+		rad_jit_sse_mem(buffer, MOVSD_LOAD, 3, R12, slot);
+	}
+	rad_jit_sse_reg(buffer, subtract ? SUBSD : ADDSD, 3, xmm);
+	rad_jit_sse_mem(buffer, MOVSD_STORE, 3, R12, slot);
+}
+
+//Emits the instruction computing slot i into xmm0 and values[i]. cached is the slot whose value xmm0 still holds.
+static void rad_jit_forward_op(rad_jit_buffer *buffer, rad_tape *tape, unsigned int i, unsigned int *cached){
+	rad_tape_op *op;
+	uintptr_t function;
+	unsigned int j;
+
+	op = tape->ops + i;
+	switch(op->operation){
+		case CONSTANT:
+			rad_jit_store_const(buffer, RBX, i, op->const_value);
+			return;
+		case INPUT:
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, R14, op->input_id);
+			break;
+		case ADD:
+		case SUBTRACT:
+		case MULTIPLY:
+		case DIVIDE:
+			if(op->operation != SUBTRACT && op->operation != DIVIDE && *cached == op->operand1 && *cached != op->operand0){
+				rad_jit_sse_mem(buffer, op->operation == ADD ? ADDSD : MULSD, 0, RBX, op->operand0);
+				break;
+			}
+			if(*cached != op->operand0){
+				rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, op->operand0);
+			}
+			switch(op->operation){
+				case ADD:
+					rad_jit_sse_mem(buffer, ADDSD, 0, RBX, op->operand1);
+					break;
+				case SUBTRACT:
+					rad_jit_sse_mem(buffer, SUBSD, 0, RBX, op->operand1);
+					break;
+				case MULTIPLY:
+					rad_jit_sse_mem(buffer, MULSD, 0, RBX, op->operand1);
+					break;
+				default:
+					rad_jit_sse_mem(buffer, DIVSD, 0, RBX, op->operand1);
+					break;
+			}
+			break;
+		case SQRT:
+			rad_jit_sse_mem(buffer, SQRTSD, 0, RBX, op->operand0);
+			break;
+		case SIGMOID:
+			//1/(1 + exp(0 - x))
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 1, RBX, op->operand0);
+			rad_jit_load_const(buffer, 0, 0);
+			rad_jit_sse_reg(buffer, SUBSD, 0, 1);
+			rad_jit_call(buffer, (uintptr_t) exp);
+			rad_jit_load_const(buffer, 1, 1);
+			rad_jit_sse_reg(buffer, ADDSD, 0, 1);
+			rad_jit_sse_reg(buffer, DIVSD, 1, 0);
+			rad_jit_sse_reg(buffer, MOVSD_LOAD, 0, 1);
+			break;
+		case EXP:
+		case LOG:
+		case SIN:
+		case COS:
+		case TANH:
+			switch(op->operation){
+				case EXP:
+					function = (uintptr_t) exp;
+					break;
+				case LOG:
+					function = (uintptr_t) log;
+					break;
+				case SIN:
+					function = (uintptr_t) sin;
+					break;
+				case COS:
+					function = (uintptr_t) cos;
+					break;
+				default:
+					function = (uintptr_t) tanh;
+					break;
+			}
+			if(*cached != op->operand0){
+				rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, op->operand0);
+			}
+			rad_jit_call(buffer, function);
+			break;
+		case POW:
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, op->operand0);
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 1, RBX, op->operand1);
+			rad_jit_call(buffer, (uintptr_t) pow);
+			break;
+		case CUSTOM:
+			for(j = 0; j < op->num_inputs; j++){
+				rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, tape->args[op->first_input + j]);
+				rad_jit_sse_mem(buffer, MOVSD_STORE, 0, RBP, j);
+			}
+			rad_jit_mov_reg(buffer, RDI, RBP);
+			rad_jit_lea(buffer, RSI, R13, op->first_input);
+			rad_jit_call(buffer, (uintptr_t) op->custom_eval);
+			break;
+		default:
+			return;
+	}
+	rad_jit_sse_mem(buffer, MOVSD_STORE, 0, RBX, i);
+	*cached = i;
+}
+
+//Emits the propagation of the adjoint of slot i, which is kept in xmm2 and reloaded after calls. Slots which no
+//instruction reads have a zero adjoint and are skipped.
+static void rad_jit_backward_op(rad_jit_buffer *buffer, rad_tape *tape, rad_jit_sweep *sweep, unsigned int i){
+	rad_tape_op *op;
+	unsigned int slot;
+	unsigned int j;
+
+	op = tape->ops + i;
+	if(op->operation == CONSTANT || !sweep->written[i]){
+		return;
+	}
+	if(sweep->cached_slot == i){
+		rad_jit_sse_reg(buffer, MOVSD_LOAD, 2, sweep->cached_xmm);
+	} else {
+		rad_jit_sse_mem(buffer, MOVSD_LOAD, 2, R12, i);
+	}
+	sweep->cached_slot = tape->num_ops;
+	switch(op->operation){
+		case INPUT:
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, R15, op->input_id);
+			rad_jit_sse_reg(buffer, ADDSD, 0, 2);
+			rad_jit_sse_mem(buffer, MOVSD_STORE, 0, R15, op->input_id);
+			break;
+		case ADD:
+		case SUBTRACT:
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 2, false);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand1, 2, op->operation == SUBTRACT);
+			break;
+		case MULTIPLY:
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, op->operand1);
+			rad_jit_sse_reg(buffer, MULSD, 0, 2);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 0, false);
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, op->operand0);
+			rad_jit_sse_reg(buffer, MULSD, 0, 2);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand1, 0, false);
+			break;
+		case DIVIDE:
+			//With t = adjoint/operand1, operand0 gets t and operand1 gets -t*value
+			rad_jit_sse_reg(buffer, MOVSD_LOAD, 0, 2);
+			rad_jit_sse_mem(buffer, DIVSD, 0, RBX, op->operand1);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 0, false);
+			rad_jit_sse_mem(buffer, MULSD, 0, RBX, i);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand1, 0, true);
+			break;
+		case POW:
+			//The helper adds to both adjoints, so they must be initialized
+			for(j = 0; j < 2; j++){
+				slot = j ? op->operand1 : op->operand0;
+				if(!sweep->written[slot]){
+					rad_jit_store_const(buffer, R12, slot, 0);
+					sweep->written[slot] = true;
+				}
+			}
+			rad_jit_mov_reg(buffer, RDI, RBX);
+			rad_jit_mov_reg(buffer, RSI, R12);
+			rad_jit_mov_imm32(buffer, RDX, i);
+			rad_jit_mov_imm32(buffer, RCX, op->operand0);
+			rad_jit_mov_imm32(buffer, R8, op->operand1);
+			rad_jit_call(buffer, (uintptr_t) rad_jit_pow_backward);
+			break;
+		case EXP:
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, i);
+			rad_jit_sse_reg(buffer, MULSD, 0, 2);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 0, false);
+			break;
+		case LOG:
+			rad_jit_sse_reg(buffer, MOVSD_LOAD, 0, 2);
+			rad_jit_sse_mem(buffer, DIVSD, 0, RBX, op->operand0);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 0, false);
+			break;
+		case SIN:
+		case COS:
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, op->operand0);
+			rad_jit_call(buffer, op->operation == SIN ? (uintptr_t) cos : (uintptr_t) sin);
+			rad_jit_sse_mem(buffer, MULSD, 0, R12, i);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 0, op->operation == COS);
+			break;
+		case TANH:
+			rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, i);
+			rad_jit_sse_reg(buffer, MULSD, 0, 0);
+			rad_jit_load_const(buffer, 1, 1);
+			rad_jit_sse_reg(buffer, SUBSD, 1, 0);
+			rad_jit_sse_reg(buffer, MULSD, 1, 2);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 1, false);
+			break;
+		case SQRT:
+			rad_jit_load_const(buffer, 0, 0.5);
+			rad_jit_sse_reg(buffer, MULSD, 0, 2);
+			rad_jit_sse_mem(buffer, DIVSD, 0, RBX, i);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 0, false);
+			break;
+		case SIGMOID:
+			rad_jit_load_const(buffer, 1, 1);
+			rad_jit_sse_mem(buffer, SUBSD, 1, RBX, i);
+			rad_jit_sse_mem(buffer, MULSD, 1, RBX, i);
+			rad_jit_sse_reg(buffer, MULSD, 1, 2);
+			rad_jit_accumulate(buffer, tape, sweep, op->operand0, 1, false);
+			break;
+		case CUSTOM:
+			for(j = 0; j < op->num_inputs; j++){
+				rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, R13, op->first_input + j);
+				rad_jit_sse_reg(buffer, MULSD, 0, 2);
+				rad_jit_accumulate(buffer, tape, sweep, tape->args[op->first_input + j], 0, false);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+//Generates the fused forward and reverse sweep of the tape. The reverse sweep is skipped when derivatives is NULL.
+static void rad_jit_generate(rad_jit_buffer *buffer, rad_tape *tape){
+	rad_jit_sweep sweep;
+	unsigned int cached;
+	size_t skip;
+	unsigned int i;
+
+	rad_jit_push(buffer, RBX);
+	rad_jit_push(buffer, RBP);
+	rad_jit_push(buffer, R12);
+	rad_jit_push(buffer, R13);
+	rad_jit_push(buffer, R14);
+	rad_jit_push(buffer, R15);
+	//sub rsp, 8 keeps the stack 16 byte aligned for calls
+	rad_jit_bytes(buffer, 0x08EC8348, 4);
+	rad_jit_mov_reg(buffer, R14, RDI);
+	rad_jit_mov_reg(buffer, R15, RSI);
+	rad_jit_mov_reg(buffer, RBX, RDX);
+	rad_jit_mov_reg(buffer, R12, RCX);
+	rad_jit_mov_reg(buffer, R13, R8);
+	rad_jit_mov_reg(buffer, RBP, R9);
+
+	cached = tape->num_ops;
+	for(i = 0; i <= tape->output; i++){
+		rad_jit_forward_op(buffer, tape, i, &cached);
+	}
+
+	//test r15, r15 and jz to the epilogue, patched below
+	rad_jit_bytes(buffer, 0xFF854D, 3);
+	rad_jit_bytes(buffer, 0x840F, 2);
+	skip = buffer->size;
+	rad_jit_bytes(buffer, 0, 4);
+
+	sweep.written = calloc(tape->num_ops, sizeof(bool));
+	sweep.cached_slot = tape->num_ops;
+	rad_jit_store_const(buffer, R12, tape->output, 1);
+	sweep.written[tape->output] = true;
+	for(i = tape->output + 1; i-- > 0;){
+		rad_jit_backward_op(buffer, tape, &sweep, i);
+	}
+	free(sweep.written);
+
+	i = buffer->size - skip - 4;
+	memcpy(buffer->code + skip, &i, 4);
+	rad_jit_sse_mem(buffer, MOVSD_LOAD, 0, RBX, tape->output);
+	rad_jit_bytes(buffer, 0x08C48348, 4);
+	rad_jit_pop(buffer, R15);
+	rad_jit_pop(buffer, R14);
+	rad_jit_pop(buffer, R13);
+	rad_jit_pop(buffer, R12);
+	rad_jit_pop(buffer, RBP);
+	rad_jit_pop(buffer, RBX);
+	rad_jit_byte(buffer, 0xC3);
+}
+
+#endif
+
+//Compiles func to a tape and the tape to native code. If native code is not supported on this platform or executable
+//memory cannot be mapped, the returned rad_jit evaluates the tape with the interpreter instead.
+rad_jit *rad_jit_create(/*not consumed*/rad_func *func){
+	rad_jit *output;
+#ifdef RAD_JIT_X86_64
+	rad_jit_buffer buffer;
+	void *code;
+#endif
+
+	output = malloc(sizeof(rad_jit));
+	output->tape = rad_compile(func);
+	if(output->tape == NULL){
+		free(output);
+		return NULL;
+	}
+	output->code = NULL;
+	output->code_size = 0;
+
+#ifdef RAD_JIT_X86_64
+	buffer.capacity = 4096;
+	buffer.size = 0;
+	buffer.code = malloc(buffer.capacity);
+	rad_jit_generate(&buffer, output->tape);
+
+	code = mmap(NULL, buffer.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(code != MAP_FAILED){
+		memcpy(code, buffer.code, buffer.size);
+		if(mprotect(code, buffer.size, PROT_READ | PROT_EXEC) == 0){
+			output->code = code;
+			output->code_size = buffer.size;
+		} else {
+			munmap(code, buffer.size);
+		}
+	}
+	free(buffer.code);
+#endif
+
+	return output;
+}
+
+void rad_jit_free(rad_jit *jit){
+#ifdef RAD_JIT_X86_64
+	if(jit->code != NULL){
+		munmap(jit->code, jit->code_size);
+	}
+#endif
+	rad_tape_free(jit->tape);
+	free(jit);
+}
+
+//Evaluates the function with ctx, which must have been created for jit->tape, and adds the gradient to derivatives
+//unless it is NULL
+double rad_jit_backward_ctx(rad_jit *jit, rad_ctx *ctx, double *inputs, double *derivatives){
+	rad_jit_entry entry;
+	double output;
+
+	if(jit->code == NULL){
+		if(derivatives == NULL){
+			return rad_eval_ctx(ctx, inputs);
+		}
+		return rad_backward_diff_ctx(ctx, inputs, derivatives);
+	}
+
+	//ISO C has no conversion from object pointers to function pointers, so the address is copied instead
+	memcpy(&entry, &jit->code, sizeof(rad_jit_entry));
+	output = entry(inputs, derivatives, ctx->values, ctx->adjoints, ctx->partials, ctx->scratch);
+	ctx->valid = jit->tape->output + 1 == jit->tape->num_ops;
+
+	return output;
+}
+
+double rad_jit_eval(rad_jit *jit, double *inputs){
+	return rad_jit_backward_ctx(jit, rad_tape_ctx(jit->tape), inputs, NULL);
+}
+
+double rad_jit_backward(rad_jit *jit, double *inputs, double *derivatives){
+	return rad_jit_backward_ctx(jit, rad_tape_ctx(jit->tape), inputs, derivatives);
+}
@@ -0,0 +1,107 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+//Consumes each function in funcs. The array itself is copied and may be freed by the caller.
+//Returns NULL if the functions cannot be compiled to a tape.
+rad_multi *rad_multi_create(rad_func **funcs, unsigned int num_outputs){
+	rad_multi *output;
+
+	output = malloc(sizeof(rad_multi));
+	output->num_outputs = num_outputs;
+	output->funcs = malloc(sizeof(rad_func *)*num_outputs);
+	memcpy(output->funcs, funcs, sizeof(rad_func *)*num_outputs);
+	output->output_slots = malloc(sizeof(unsigned int)*num_outputs);
+	output->values = calloc(num_outputs, sizeof(double));
+	output->tape = rad_compile_roots(output->funcs, num_outputs, output->output_slots);
+	output->jacobian_pattern = NULL;
+	output->num_colors = 0;
+	output->colors = NULL;
+	if(output->tape == NULL){
+		rad_multi_free(output);
+		return NULL;
+	}
+
+	return output;
+}
+
+void rad_multi_free(rad_multi *multi){
+	unsigned int i;
+
+	for(i = 0; i < multi->num_outputs; i++){
+		rad_discard(multi->funcs[i]);
+	}
+	if(multi->tape != NULL){
+		rad_tape_free(multi->tape);
+	}
+	if(multi->jacobian_pattern != NULL){
+		rad_csr_free(multi->jacobian_pattern);
+	}
+	free(multi->colors);
+	free(multi->funcs);
+	free(multi->output_slots);
+	free(multi->values);
+	free(multi);
+}
+
+//Runs the shared forward pass and returns the number of tape slots the reverse sweeps must visit
+static unsigned int rad_multi_forward(rad_multi *multi, double *inputs){
+	rad_ctx *ctx;
+	unsigned int num_ops = 0;
+	unsigned int i;
+
+	ctx = rad_tape_ctx(multi->tape);
+	rad_ctx_forward(ctx, inputs);
+	for(i = 0; i < multi->num_outputs; i++){
+		multi->values[i] = ctx->values[multi->output_slots[i]];
+		if(multi->output_slots[i] + 1 > num_ops){
+			num_ops = multi->output_slots[i] + 1;
+		}
+	}
+
+	return num_ops;
+}
+
+void rad_multi_eval(rad_multi *multi, double *inputs, double *outputs){
+	rad_multi_forward(multi, inputs);
+	if(outputs != NULL){
+		memcpy(outputs, multi->values, sizeof(double)*multi->num_outputs);
+	}
+}
+
+//Adds the gradient of sum(cotangent[i]*output i) to derivatives, using a single forward and a single reverse pass
+void rad_vjp(rad_multi *multi, double *inputs, double *cotangent, double *derivatives){
+	rad_ctx *ctx;
+	unsigned int num_ops;
+	unsigned int i;
+
+	ctx = rad_tape_ctx(multi->tape);
+	num_ops = rad_multi_forward(multi, inputs);
+	memset(ctx->adjoints, 0, sizeof(double)*num_ops);
+	for(i = 0; i < multi->num_outputs; i++){
+		ctx->adjoints[multi->output_slots[i]] += cotangent[i];
+	}
+	rad_ctx_reverse(ctx, num_ops, derivatives);
+}
+
+//Stores the Jacobian in row-major order, so the derivative of output i by input j is jacobian[i*num_inputs + j],
+//where num_inputs is one more than the largest input id used. All rows share one forward pass.
+void rad_jacobian(rad_multi *multi, double *inputs, double *jacobian){
+	rad_ctx *ctx;
+	unsigned int num_inputs;
+	unsigned int slot;
+	unsigned int i;
+
+	ctx = rad_tape_ctx(multi->tape);
+	num_inputs = multi->tape->num_inputs;
+	rad_multi_forward(multi, inputs);
+	memset(jacobian, 0, sizeof(double)*multi->num_outputs*num_inputs);
+	for(i = 0; i < multi->num_outputs; i++){
+		slot = multi->output_slots[i];
+		memset(ctx->adjoints, 0, sizeof(double)*(slot + 1));
+		ctx->adjoints[slot] = 1;
+		rad_ctx_reverse(ctx, slot + 1, jacobian + i*num_inputs);
+	}
+}
@@ -1,34 +1,28 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <limits.h>
 #include <time.h>
 #include "rad.h"
 
-rad_func *activation;
+#ifdef NEURON_COMPILED
+//Generated from the error function by running ./neuron_test emit neuron_net.c
+double neuron_error(const double *inputs, double *derivatives);
+#endif
 
 rad_func **new_layer(unsigned int num_neurons, rad_func **prev_layer, unsigned int prev_neurons, unsigned int *parameter){
 	rad_func **output;
-	rad_func *neuron;
+	rad_func *layer;
 	unsigned int i;
-	unsigned int j;
 
 	output = malloc(sizeof(rad_func *)*num_neurons);
+	layer = rad_dense(*parameter, prev_neurons, num_neurons, prev_layer);
+	*parameter += num_neurons*(prev_neurons + 1);
 	for(i = 0; i < num_neurons; i++){
-		neuron = rad_multiply(rad_copy(prev_layer[0]), rad_input(*parameter));
-		++*parameter;
-		for(j = 1; j < prev_neurons; j++){
-			neuron = rad_add(neuron, rad_multiply(rad_copy(prev_layer[j]), rad_input(*parameter)));
-			++*parameter;
-		}
-		neuron = rad_add(neuron, rad_input(*parameter));
-		++*parameter;
-		output[i] = rad_composition(rad_copy(activation), 1, neuron);
-	}
-
-	for(i = 0; i < prev_neurons; i++){
-		rad_discard(prev_layer[i]);
+		output[i] = rad_sigmoid(rad_dense_output(rad_copy(layer), i));
 	}
+	rad_discard(layer);
 
 	return output;
 }
@@ -68,7 +62,11 @@ double rad_teach(rad_func *error_func, double *parameters, double *derivs, doubl
 	for(i = parameter_start; i < num_parameters; i++){
 		derivs[i] *= 0.75;
 	}
+#ifdef NEURON_COMPILED
+	error = neuron_error(parameters, derivs);
+#else
 	error = rad_backward_diff(error_func, parameters, derivs);
+#endif
 	for(i = parameter_start; i < num_parameters; i++){
 		parameters[i] -= derivs[i]*c;
 	}
@@ -76,11 +74,6 @@ double rad_teach(rad_func *error_func, double *parameters, double *derivs, doubl
 	return error;
 }
 
-double custom_exp(double *input, double *grad){
-	*grad = exp(*input);
-	return *grad;
-}
-
 int main(int argc, char **argv){
 	rad_func **layer0;
 	rad_func **layer1;
@@ -93,15 +86,27 @@ int main(int argc, char **argv){
 	double *parameters;
 	double *derivatives;
 	double error;
+	FILE *file;
 
 	srand(time(NULL));
-	activation = rad_parse("1/(1 + {0})", rad_custom(custom_exp, 1, rad_parse("0.0 - [0]")));
 
 	layer0 = input_layer(2, 1);
 	layer1 = new_layer(3, layer0, 2, &parameter);
 	layer2 = new_layer(1, layer1, 3, &parameter);
 	error_func = net_error(layer2, 1);
 
+	if(argc == 3 && !strcmp(argv[1], "emit")){
+		file = fopen(argv[2], "w");
+		rad_emit_c(error_func, file, "neuron_error");
+		fclose(file);
+		rad_discard(error_func);
+		rad_discard(layer2[0]);
+		free(layer2);
+		free(layer1);
+		free(layer0);
+		return 0;
+	}
+
 	parameters = malloc(sizeof(double)*parameter);
 	derivatives = malloc(sizeof(double)*parameter);
 
@@ -121,7 +126,11 @@ int main(int argc, char **argv){
 		parameters[1] = in0;
 		parameters[2] = in1;
 		error = rad_teach(error_func, parameters, derivatives, 0.05, parameter, 3);
+#ifdef NEURON_COMPILED
+		printf("%u %u %d - error: %lf\n", in0, in1, in0 != in1, error);
+#else
 		printf("%u %u %d %lf - error: %lf\n", in0, in1, in0 != in1, layer2[0]->value, error);
+#endif
 	}
 
 	printf("parameters: ");
@@ -134,7 +143,6 @@ int main(int argc, char **argv){
 	free(derivatives);
 	rad_discard(error_func);
 	rad_discard(layer2[0]);
-	rad_discard(activation);
 	free(layer2);
 	free(layer1);
 	free(layer0);
@@ -0,0 +1,662 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+//Hash set of nodes keyed by their operation, leaf data and (already merged) children
+typedef struct rad_node_set rad_node_set;
+
+struct rad_node_set{
+	unsigned int capacity;
+	unsigned int size;
+	rad_func **nodes;
+};
+
+static uint64_t rad_hash_combine(uint64_t hash, uint64_t value){
+	hash ^= value + 0x9E3779B97F4A7C15ULL + (hash<<6) + (hash>>2);
+	return hash;
+}
+
+static uint64_t rad_hash_pointer(const void *ptr, size_t size){
+	uint64_t output = 0;
+
+	memcpy(&output, ptr, size < sizeof(output) ? size : sizeof(output));
+	return output;
+}
+
+static uint64_t rad_signature_hash(rad_func *func){
+	uint64_t output;
+	unsigned int i;
+
+	output = func->operation;
+	switch(func->operation){
+		case CONSTANT:
+			output = rad_hash_combine(output, rad_hash_pointer(&func->const_value, sizeof(double)));
+			break;
+		case INPUT:
+			output = rad_hash_combine(output, func->input_id);
+			break;
+		case ARG:
+			output = rad_hash_combine(output, func->arg_id);
+			break;
+		case COMPOSITION:
+			output = rad_hash_combine(output, (uintptr_t) func->func);
+			break;
+		case CUSTOM:
+			output = rad_hash_combine(output, rad_hash_pointer(&func->custom_eval, sizeof(func->custom_eval)));
+			break;
+		case DENSE:
+			output = rad_hash_combine(output, func->weight_base);
+			output = rad_hash_combine(output, func->num_outputs);
+			break;
+		case DENSE_OUTPUT:
+			output = rad_hash_combine(output, func->output_index);
+			break;
+		default:
+			break;
+	}
+	for(i = 0; i < rad_num_children(func); i++){
+		output = rad_hash_combine(output, (uintptr_t) rad_child(func, i));
+	}
+	output ^= output>>29;
+
+	return output;
+}
+
+static bool rad_same_signature(rad_func *a, rad_func *b){
+	unsigned int i;
+
+	if(a->operation != b->operation){
+		return false;
+	}
+	switch(a->operation){
+		case CONSTANT:
+			return !memcmp(&a->const_value, &b->const_value, sizeof(double));
+		case INPUT:
+			return a->input_id == b->input_id;
+		case ARG:
+			return a->arg_id == b->arg_id;
+		case COMPOSITION:
+			if(a->func != b->func || a->num_inputs != b->num_inputs){
+				return false;
+			}
+			break;
+		case CUSTOM:
+			if(a->custom_eval != b->custom_eval || a->num_inputs != b->num_inputs){
+				return false;
+			}
+			break;
+		case DENSE:
+			if(a->weight_base != b->weight_base || a->num_inputs != b->num_inputs || a->num_outputs != b->num_outputs){
+				return false;
+			}
+			break;
+		case DENSE_OUTPUT:
+			if(a->output_index != b->output_index){
+				return false;
+			}
+			break;
+		default:
+			break;
+	}
+	for(i = 0; i < rad_num_children(a); i++){
+		if(rad_child(a, i) != rad_child(b, i)){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void rad_node_set_init(rad_node_set *set){
+	set->capacity = 16;
+	set->size = 0;
+	set->nodes = calloc(set->capacity, sizeof(rad_func *));
+}
+
+static rad_func *rad_node_set_insert(rad_node_set *set, rad_func *func);
+
+static void rad_node_set_grow(rad_node_set *set){
+	rad_func **old_nodes;
+	unsigned int old_capacity;
+	unsigned int i;
+
+	old_nodes = set->nodes;
+	old_capacity = set->capacity;
+	set->capacity *= 2;
+	set->size = 0;
+	set->nodes = calloc(set->capacity, sizeof(rad_func *));
+	for(i = 0; i < old_capacity; i++){
+		if(old_nodes[i] != NULL){
+			rad_node_set_insert(set, old_nodes[i]);
+		}
+	}
+	free(old_nodes);
+}
+
+//Returns the node already in the set with the same signature as func, or inserts and returns func
+static rad_func *rad_node_set_insert(rad_node_set *set, rad_func *func){
+	unsigned int i;
+
+	if(2*(set->size + 1) > set->capacity){
+		rad_node_set_grow(set);
+	}
+
+	i = rad_signature_hash(func)&(set->capacity - 1);
+	while(set->nodes[i] != NULL){
+		if(rad_same_signature(set->nodes[i], func)){
+			return set->nodes[i];
+		}
+		i = (i + 1)&(set->capacity - 1);
+	}
+	set->nodes[i] = func;
+	set->size++;
+
+	return func;
+}
+
+//Merges the duplicate nodes of one graph. The functions inside compositions are collected in inner_funcs
+//and merged separately, since their INPUT nodes refer to the composition's arguments.
+static unsigned int rad_cse_scope(rad_func *func, rad_node_map *inner_funcs, rad_func ***worklist, unsigned int *worklist_size, unsigned int *worklist_capacity){
+	rad_node_map map;
+	rad_node_set set;
+	rad_func **order;
+	rad_func **canonical;
+	rad_func **child;
+	rad_func *node;
+	unsigned int num_nodes;
+	unsigned int index;
+	unsigned int removed = 0;
+	unsigned int i;
+	unsigned int j;
+
+	rad_node_map_init(&map);
+	order = rad_topological_order(func, &num_nodes, &map);
+	canonical = malloc(sizeof(rad_func *)*num_nodes);
+	rad_node_set_init(&set);
+
+	for(i = 0; i < num_nodes; i++){
+		node = order[i];
+		for(j = 0; j < rad_num_children(node); j++){
+			child = rad_child_pointer(node, j);
+			rad_node_map_get(&map, *child, &index);
+			if(canonical[index] != *child){
+				rad_copy(canonical[index]);
+				rad_discard(*child);
+				*child = canonical[index];
+			}
+		}
+		if(node->operation == COMPOSITION && !rad_node_map_get(inner_funcs, node->func, NULL)){
+			rad_node_map_set(inner_funcs, node->func, 0);
+			if(*worklist_size == *worklist_capacity){
+				*worklist_capacity *= 2;
+				*worklist = realloc(*worklist, sizeof(rad_func *)*(*worklist_capacity));
+			}
+			(*worklist)[*worklist_size] = node->func;
+			++*worklist_size;
+		}
+		canonical[i] = rad_node_set_insert(&set, node);
+		if(canonical[i] != node){
+			removed++;
+		}
+	}
+
+	free(set.nodes);
+	free(canonical);
+	free(order);
+	rad_node_map_free(&map);
+
+	return removed;
+}
+
+//Merges structurally identical subexpressions of func into shared nodes and returns the number of nodes removed
+unsigned int rad_cse(/*not consumed*/rad_func *func){
+	rad_node_map inner_funcs;
+	rad_func **worklist;
+	unsigned int worklist_size = 1;
+	unsigned int worklist_capacity = 16;
+	unsigned int removed = 0;
+
+	rad_node_map_init(&inner_funcs);
+	worklist = malloc(sizeof(rad_func *)*worklist_capacity);
+	worklist[0] = func;
+	while(worklist_size){
+		worklist_size--;
+		removed += rad_cse_scope(worklist[worklist_size], &inner_funcs, &worklist, &worklist_size, &worklist_capacity);
+	}
+
+	free(worklist);
+	rad_node_map_free(&inner_funcs);
+
+	return removed;
+}
+
+static bool rad_is_const(rad_func *func, double value){
+	return func->operation == CONSTANT && func->const_value == value;
+}
+
+static bool rad_all_inputs_const(rad_func **inputs, unsigned int num_inputs){
+	unsigned int i;
+
+	for(i = 0; i < num_inputs; i++){
+		if(inputs[i]->operation != CONSTANT){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//Builds the simplified form of a binary node from its simplified operands. The rules x*0 = 0 and 0/x = 0 are
+//applied even though they do not hold when x is infinite or NaN.
+static rad_func *rad_simplify_binary(rad_func *func, rad_func *operand0, rad_func *operand1){
+	rad_func *output;
+
+	if(operand0->operation == CONSTANT && operand1->operation == CONSTANT){
+		switch(func->operation){
+			case ADD:
+				return rad_const(operand0->const_value + operand1->const_value);
+			case SUBTRACT:
+				return rad_const(operand0->const_value - operand1->const_value);
+			case MULTIPLY:
+				return rad_const(operand0->const_value*operand1->const_value);
+			case DIVIDE:
+				return rad_const(operand0->const_value/operand1->const_value);
+			case POW:
+				return rad_const(pow(operand0->const_value, operand1->const_value));
+			default:
+				break;
+		}
+	}
+
+	switch(func->operation){
+		case ADD:
+			if(rad_is_const(operand0, 0)){
+				return rad_copy(operand1);
+			} else if(rad_is_const(operand1, 0)){
+				return rad_copy(operand0);
+			}
+			break;
+		case SUBTRACT:
+			if(rad_is_const(operand1, 0)){
+				return rad_copy(operand0);
+			}
+			break;
+		case MULTIPLY:
+			if(rad_is_const(operand0, 0) || rad_is_const(operand1, 0)){
+				return rad_const(0);
+			} else if(rad_is_const(operand0, 1)){
+				return rad_copy(operand1);
+			} else if(rad_is_const(operand1, 1)){
+				return rad_copy(operand0);
+			}
+			break;
+		case DIVIDE:
+			if(rad_is_const(operand1, 1)){
+				return rad_copy(operand0);
+			} else if(rad_is_const(operand0, 0)){
+				return rad_const(0);
+			}
+			break;
+		case POW:
+			if(rad_is_const(operand1, 1)){
+				return rad_copy(operand0);
+			} else if(rad_is_const(operand1, 0)){
+				return rad_const(1);
+			}
+			break;
+		default:
+			break;
+	}
+
+	if(operand0 == func->operand0 && operand1 == func->operand1){
+		return rad_copy(func);
+	}
+	output = rad_create_func(func->operation, 1);
+	output->operand0 = rad_copy(operand0);
+	output->operand1 = rad_copy(operand1);
+
+	return output;
+}
+
+static rad_func *rad_simplify_unary(rad_func *func, rad_func *operand0){
+	rad_func *output;
+
+	if(operand0->operation == CONSTANT){
+		return rad_const(rad_unary_eval(func->operation, operand0->const_value));
+	}
+	if(operand0 == func->operand0){
+		return rad_copy(func);
+	}
+	output = rad_create_func(func->operation, 1);
+	output->operand0 = rad_copy(operand0);
+	output->operand1 = NULL;
+
+	return output;
+}
+
+//Returns a new DENSE or DENSE_OUTPUT node like func, with new references to children in place of its children
+static rad_func *rad_rebuild_dense(rad_func *func, rad_func **children){
+	rad_func *output;
+	unsigned int i;
+
+	if(func->operation == DENSE_OUTPUT){
+		return rad_dense_output(rad_copy(children[0]), func->output_index);
+	}
+	output = rad_create_dense(func->weight_base, func->num_inputs, func->num_outputs);
+	for(i = 0; i < func->num_inputs; i++){
+		output->inputs[i] = rad_copy(children[i]);
+	}
+
+	return output;
+}
+
+static rad_func *rad_simplify_scope(rad_func *func, rad_node_map *inner_map, rad_func ***inner_results, unsigned int *num_inner, unsigned int *inner_capacity);
+
+//Builds the simplified form of a COMPOSITION or CUSTOM node. Custom functions with constant arguments are
+//folded by calling them once, so they must not have side effects.
+static rad_func *rad_simplify_inputs(rad_func *func, rad_func **inputs, rad_node_map *inner_map, rad_func ***inner_results, unsigned int *num_inner, unsigned int *inner_capacity){
+	rad_func *inner = NULL;
+	rad_func *output;
+	double *values;
+	double value;
+	unsigned int index;
+	unsigned int i;
+	bool changed = false;
+
+	if(func->operation == COMPOSITION){
+		if(!rad_node_map_get(inner_map, func->func, &index)){
+			inner = rad_simplify_scope(func->func, inner_map, inner_results, num_inner, inner_capacity);
+			if(*num_inner == *inner_capacity){
+				*inner_capacity *= 2;
+				*inner_results = realloc(*inner_results, sizeof(rad_func *)*(*inner_capacity));
+			}
+			index = *num_inner;
+			(*inner_results)[index] = inner;
+			++*num_inner;
+			rad_node_map_set(inner_map, func->func, index);
+		}
+		inner = (*inner_results)[index];
+		if(inner->operation == CONSTANT){
+			return rad_copy(inner);
+		} else if(inner->operation == INPUT && inner->input_id < func->num_inputs){
+			return rad_copy(inputs[inner->input_id]);
+		}
+		changed = inner != func->func;
+	}
+
+	if(rad_all_inputs_const(inputs, func->num_inputs)){
+		values = malloc(sizeof(double)*2*(func->num_inputs ? func->num_inputs : 1));
+		for(i = 0; i < func->num_inputs; i++){
+			values[i] = inputs[i]->const_value;
+		}
+		if(func->operation == COMPOSITION){
+			value = rad_eval(inner, values);
+		} else {
+			value = func->custom_eval(values, values + func->num_inputs);
+		}
+		free(values);
+		return rad_const(value);
+	}
+
+	for(i = 0; i < func->num_inputs; i++){
+		if(inputs[i] != func->inputs[i]){
+			changed = true;
+		}
+	}
+	if(!changed){
+		return rad_copy(func);
+	}
+
+	output = rad_create_func_inputs(func->operation, func->num_inputs);
+	if(func->operation == COMPOSITION){
+		output->func = rad_copy(inner);
+	} else {
+		output->custom_eval = func->custom_eval;
+	}
+	for(i = 0; i < func->num_inputs; i++){
+		output->inputs[i] = rad_copy(inputs[i]);
+	}
+
+	return output;
+}
+
+//Returns a new reference to the simplified form of func, sharing every node which did not change
+static rad_func *rad_simplify_scope(rad_func *func, rad_node_map *inner_map, rad_func ***inner_results, unsigned int *num_inner, unsigned int *inner_capacity){
+	rad_node_map map;
+	rad_func **order;
+	rad_func **results;
+	rad_func **inputs;
+	rad_func *node;
+	rad_func *output;
+	unsigned int num_nodes;
+	unsigned int index0;
+	unsigned int index1;
+	unsigned int i;
+	unsigned int j;
+	bool changed;
+
+	rad_node_map_init(&map);
+	order = rad_topological_order(func, &num_nodes, &map);
+	results = malloc(sizeof(rad_func *)*num_nodes);
+
+	for(i = 0; i < num_nodes; i++){
+		node = order[i];
+		switch(node->operation){
+			case ADD:
+			case SUBTRACT:
+			case MULTIPLY:
+			case DIVIDE:
+			case POW:
+				rad_node_map_get(&map, node->operand0, &index0);
+				rad_node_map_get(&map, node->operand1, &index1);
+				results[i] = rad_simplify_binary(node, results[index0], results[index1]);
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				rad_node_map_get(&map, node->operand0, &index0);
+				results[i] = rad_simplify_unary(node, results[index0]);
+				break;
+			case COMPOSITION:
+			case CUSTOM:
+				inputs = malloc(sizeof(rad_func *)*(node->num_inputs ? node->num_inputs : 1));
+				for(j = 0; j < node->num_inputs; j++){
+					rad_node_map_get(&map, node->inputs[j], &index0);
+					inputs[j] = results[index0];
+				}
+				results[i] = rad_simplify_inputs(node, inputs, inner_map, inner_results, num_inner, inner_capacity);
+				free(inputs);
+				break;
+			case DENSE:
+			case DENSE_OUTPUT:
+				inputs = malloc(sizeof(rad_func *)*(rad_num_children(node) ? rad_num_children(node) : 1));
+				changed = false;
+				for(j = 0; j < rad_num_children(node); j++){
+					rad_node_map_get(&map, rad_child(node, j), &index0);
+					inputs[j] = results[index0];
+					changed = changed || inputs[j] != rad_child(node, j);
+				}
+				if(changed){
+					results[i] = rad_rebuild_dense(node, inputs);
+				} else {
+					results[i] = rad_copy(node);
+				}
+				free(inputs);
+				break;
+			default:
+				results[i] = rad_copy(node);
+				break;
+		}
+	}
+
+	output = rad_copy(results[num_nodes - 1]);
+	for(i = 0; i < num_nodes; i++){
+		rad_discard(results[i]);
+	}
+	free(results);
+	free(order);
+	rad_node_map_free(&map);
+
+	return output;
+}
+
+//Folds constant subexpressions and applies the identities x + 0 = x, x - 0 = x, x*1 = x, x/1 = x, x*0 = 0, 0/x = 0,
+//pow(x, 1) = x and pow(x, 0) = 1.
+//Consumes func and returns the simplified function. Subexpressions which are no longer used are discarded.
+rad_func *rad_simplify(rad_func *func){
+	rad_node_map inner_map;
+	rad_func **inner_results;
+	rad_func *output;
+	unsigned int num_inner = 0;
+	unsigned int inner_capacity = 16;
+	unsigned int i;
+
+	rad_node_map_init(&inner_map);
+	inner_results = malloc(sizeof(rad_func *)*inner_capacity);
+	output = rad_simplify_scope(func, &inner_map, &inner_results, &num_inner, &inner_capacity);
+	for(i = 0; i < num_inner; i++){
+		rad_discard(inner_results[i]);
+	}
+	free(inner_results);
+	rad_node_map_free(&inner_map);
+	rad_discard(func);
+
+	return output;
+}
+
+//Returns the input id which the weights of a dense layer start at once the INPUT nodes are replaced by args. The layer
+//can only be kept if its weights are consecutive inputs of the composition which are themselves consecutive inputs.
+static bool rad_inline_weight_base(rad_func *func, rad_func **args, unsigned int num_args, unsigned int *weight_base){
+	size_t num_weights;
+	size_t i;
+
+	num_weights = (size_t) func->num_outputs*(func->num_inputs + 1);
+	if(args == NULL){
+		*weight_base = func->weight_base;
+		return true;
+	}
+	if(func->weight_base > num_args || num_args - func->weight_base < num_weights){
+		return false;
+	}
+	for(i = 0; i < num_weights; i++){
+		if(args[func->weight_base + i]->operation != INPUT || args[func->weight_base + i]->input_id != args[func->weight_base]->input_id + i){
+			return false;
+		}
+	}
+	*weight_base = num_weights ? args[func->weight_base]->input_id : 0;
+
+	return true;
+}
+
+//Returns a new reference to func with the INPUT nodes replaced by args, or kept if args is NULL, and every composition
+//replaced by its function applied to its inputs. Nodes which do not change are shared. Returns NULL if func has a dense
+//layer whose weights cannot be replaced by args, and a composition of such a function is kept with its function inlined.
+static rad_func *rad_inline_scope(rad_func *func, rad_func **args, unsigned int num_args){
+	rad_node_map map;
+	rad_func **order;
+	rad_func **results;
+	rad_func **inputs;
+	rad_func *node;
+	rad_func *output;
+	unsigned int num_nodes;
+	unsigned int num_children;
+	unsigned int weight_base;
+	unsigned int index;
+	unsigned int i;
+	unsigned int j;
+	bool changed;
+	bool success = true;
+
+	rad_node_map_init(&map);
+	order = rad_topological_order(func, &num_nodes, &map);
+	results = malloc(sizeof(rad_func *)*num_nodes);
+
+	for(i = 0; i < num_nodes && success; i++){
+		node = order[i];
+		num_children = rad_num_children(node);
+		inputs = malloc(sizeof(rad_func *)*(num_children ? num_children : 1));
+		changed = false;
+		for(j = 0; j < num_children; j++){
+			rad_node_map_get(&map, rad_child(node, j), &index);
+			inputs[j] = results[index];
+			changed = changed || inputs[j] != rad_child(node, j);
+		}
+
+		if(node->operation == INPUT && args != NULL && node->input_id < num_args){
+			results[i] = rad_copy(args[node->input_id]);
+		} else if(node->operation == COMPOSITION){
+			results[i] = rad_inline_scope(node->func, inputs, num_children);
+			if(results[i] == NULL){
+				results[i] = rad_create_func_inputs(COMPOSITION, num_children);
+				results[i]->func = rad_inline_scope(node->func, NULL, 0);
+				for(j = 0; j < num_children; j++){
+					results[i]->inputs[j] = rad_copy(inputs[j]);
+				}
+			}
+		} else if(node->operation == DENSE){
+			success = rad_inline_weight_base(node, args, num_args, &weight_base);
+			if(!success){
+				free(inputs);
+				break;
+			}
+			if(!changed && weight_base == node->weight_base){
+				results[i] = rad_copy(node);
+			} else {
+				results[i] = rad_rebuild_dense(node, inputs);
+				results[i]->weight_base = weight_base;
+			}
+		} else if(!changed){
+			results[i] = rad_copy(node);
+		} else if(node->operation == CUSTOM){
+			results[i] = rad_create_func_inputs(CUSTOM, num_children);
+			results[i]->custom_eval = node->custom_eval;
+			for(j = 0; j < num_children; j++){
+				results[i]->inputs[j] = rad_copy(inputs[j]);
+			}
+		} else if(node->operation == DENSE_OUTPUT){
+			results[i] = rad_rebuild_dense(node, inputs);
+		} else {
+			results[i] = rad_create_func(node->operation, 1);
+			results[i]->operand1 = NULL;
+			for(j = 0; j < num_children; j++){
+				*rad_child_pointer(results[i], j) = rad_copy(inputs[j]);
+			}
+		}
+		free(inputs);
+	}
+
+	if(success){
+		output = rad_copy(results[num_nodes - 1]);
+	} else {
+		output = NULL;
+		num_nodes = i;
+	}
+	for(i = 0; i < num_nodes; i++){
+		rad_discard(results[i]);
+	}
+	free(results);
+	free(order);
+	rad_node_map_free(&map);
+
+	return output;
+}
+
+//Replaces every composition with a copy of its function whose INPUT nodes are the composition's inputs, so evaluation
+//does not need nested calls. Each composition gets its own copy, which rad_cse can merge where the inputs are the same.
+//Compositions of functions with dense layers are only inlined if the weights they pass are consecutive inputs.
+//Consumes func and returns the inlined function.
+rad_func *rad_inline(rad_func *func){
+	rad_func *output;
+
+	output = rad_inline_scope(func, NULL, 0);
+	rad_discard(func);
+
+	return output;
+}
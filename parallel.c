@@ -0,0 +1,169 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <math.h>
+#include "rad.h"
+
+//Workers wait behind the gate until the threads which could be started are known and their shares are assigned
+typedef struct rad_worker_gate rad_worker_gate;
+
+struct rad_worker_gate{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool open;
+};
+
+typedef struct rad_worker rad_worker;
+
+//Each worker differentiates a contiguous share of the samples into its own gradient buffer
+struct rad_worker{
+	rad_ctx *ctx;
+	unsigned int index;
+	unsigned int num_workers;
+	rad_worker *workers;
+	rad_worker_gate *gate;
+	pthread_barrier_t *barrier;
+	double *samples;
+	unsigned int num_samples;
+	unsigned int stride;
+	double *outputs;
+	double *gradient;
+	double value;
+};
+
+static void *rad_worker_run(void *arg){
+	rad_worker *worker;
+	rad_worker *partner;
+	unsigned int num_inputs;
+	unsigned int step;
+	unsigned int i;
+
+	worker = arg;
+	pthread_mutex_lock(&worker->gate->mutex);
+	while(!worker->gate->open){
+		pthread_cond_wait(&worker->gate->cond, &worker->gate->mutex);
+	}
+	pthread_mutex_unlock(&worker->gate->mutex);
+
+	num_inputs = worker->ctx->tape->num_inputs;
+	memset(worker->gradient, 0, sizeof(double)*num_inputs);
+	worker->value = 0;
+	if(worker->num_samples){
+		rad_backward_diff_batch_ctx(worker->ctx, worker->samples, worker->num_samples, worker->stride, worker->outputs, worker->gradient, 0);
+		for(i = 0; i < worker->num_samples; i++){
+			worker->value += worker->outputs[i];
+		}
+	}
+
+	//Pairwise tree reduction: in each round, worker i adds in the buffer of worker i + step.
+	//The barrier guarantees the partner has finished all earlier rounds, so no locks are needed.
+	for(step = 1; step < worker->num_workers; step *= 2){
+		pthread_barrier_wait(worker->barrier);
+		if(worker->index%(2*step) == 0 && worker->index + step < worker->num_workers){
+			partner = worker->workers + worker->index + step;
+			for(i = 0; i < num_inputs; i++){
+				worker->gradient[i] += partner->gradient[i];
+			}
+			worker->value += partner->value;
+		}
+	}
+
+	return NULL;
+}
+
+//Adds the gradient summed over all samples to derivatives and returns the summed value.
+//If num_threads is zero, one thread is used per online processor.
+double rad_tape_backward_parallel(rad_tape *tape, double *samples, unsigned int num_samples, unsigned int stride, double *derivatives, unsigned int num_threads){
+	rad_worker *workers;
+	rad_worker_gate gate;
+	pthread_t *threads;
+	pthread_barrier_t barrier;
+	unsigned int start = 0;
+	unsigned int share;
+	unsigned int i;
+	long num_processors;
+	double output;
+
+	if(num_threads == 0){
+		num_processors = sysconf(_SC_NPROCESSORS_ONLN);
+		num_threads = num_processors > 0 ? num_processors : 1;
+	}
+	if(num_threads > num_samples){
+		num_threads = num_samples ? num_samples : 1;
+	}
+
+	workers = malloc(sizeof(rad_worker)*num_threads);
+	threads = malloc(sizeof(pthread_t)*num_threads);
+	pthread_mutex_init(&gate.mutex, NULL);
+	pthread_cond_init(&gate.cond, NULL);
+	gate.open = false;
+	workers[0].gate = &gate;
+
+	//If a thread cannot be started, the samples are shared among the threads which were
+	for(i = 1; i < num_threads; i++){
+		workers[i].gate = &gate;
+		if(pthread_create(threads + i, NULL, rad_worker_run, workers + i)){
+			num_threads = i;
+			break;
+		}
+	}
+
+	pthread_barrier_init(&barrier, NULL, num_threads);
+	for(i = 0; i < num_threads; i++){
+		share = num_samples/num_threads + (i < num_samples%num_threads);
+		workers[i].ctx = rad_ctx_create(tape);
+		workers[i].index = i;
+		workers[i].num_workers = num_threads;
+		workers[i].workers = workers;
+		workers[i].barrier = &barrier;
+		workers[i].samples = samples + (size_t) start*stride;
+		workers[i].num_samples = share;
+		workers[i].stride = stride;
+		workers[i].outputs = malloc(sizeof(double)*(share ? share : 1));
+		workers[i].gradient = malloc(sizeof(double)*(tape->num_inputs ? tape->num_inputs : 1));
+		start += share;
+	}
+
+	pthread_mutex_lock(&gate.mutex);
+	gate.open = true;
+	pthread_cond_broadcast(&gate.cond);
+	pthread_mutex_unlock(&gate.mutex);
+	rad_worker_run(workers);
+	for(i = 1; i < num_threads; i++){
+		pthread_join(threads[i], NULL);
+	}
+
+	for(i = 0; i < tape->num_inputs; i++){
+		derivatives[i] += workers[0].gradient[i];
+	}
+	output = workers[0].value;
+
+	for(i = 0; i < num_threads; i++){
+		rad_ctx_free(workers[i].ctx);
+		free(workers[i].outputs);
+		free(workers[i].gradient);
+	}
+	pthread_barrier_destroy(&barrier);
+	pthread_cond_destroy(&gate.cond);
+	pthread_mutex_destroy(&gate.mutex);
+	free(threads);
+	free(workers);
+
+	return output;
+}
+
+double rad_backward_diff_parallel(rad_func *func, double *samples, unsigned int num_samples, unsigned int stride, double *derivatives, unsigned int num_threads){
+	rad_tape *tape;
+	double output;
+
+	tape = rad_compile(func);
+	if(tape == NULL){
+		return NAN;
+	}
+	output = rad_tape_backward_parallel(tape, samples, num_samples, stride, derivatives, num_threads);
+	rad_tape_free(tape);
+
+	return output;
+}
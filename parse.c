@@ -6,9 +6,24 @@
 #include <stdarg.h>
 #include <math.h>
 #include "rad.h"
+#include "rad_internal.h"
 
 static int rad_order_of_operations[] = {-1, -1, 0, 0, 1, 1};
 
+static struct{
+	const char *name;
+	enum rad_oper operation;
+} rad_parse_functions[] = {
+	{"exp", EXP},
+	{"log", LOG},
+	{"sin", SIN},
+	{"cos", COS},
+	{"tanh", TANH},
+	{"sqrt", SQRT},
+	{"sigmoid", SIGMOID},
+	{"pow", POW}
+};
+
 static rad_func *rad_parse_internal(const char **c, unsigned int *num_args);
 
 static void skip_whitespace(const char **c){
@@ -17,6 +32,68 @@ static void skip_whitespace(const char **c){
 	}
 }
 
+//Parses a call such as exp([0]) or pow([0], 2), starting at the function name
+static rad_func *rad_parse_call(const char **c, unsigned int *num_args){
+	const char *name;
+	size_t length;
+	unsigned int i;
+	rad_func *operand0;
+	rad_func *operand1 = NULL;
+	rad_func *output;
+
+	name = *c;
+	while((**c >= 'a' && **c <= 'z') || (**c >= 'A' && **c <= 'Z')){
+		++*c;
+	}
+	length = *c - name;
+	for(i = 0; i < sizeof(rad_parse_functions)/sizeof(rad_parse_functions[0]); i++){
+		if(strlen(rad_parse_functions[i].name) == length && !strncmp(rad_parse_functions[i].name, name, length)){
+			break;
+		}
+	}
+	if(i == sizeof(rad_parse_functions)/sizeof(rad_parse_functions[0])){
+		return NULL;
+	}
+
+	skip_whitespace(c);
+	if(**c != '('){
+		return NULL;
+	}
+	++*c;
+	operand0 = rad_parse_internal(c, num_args);
+	if(operand0 == NULL){
+		return NULL;
+	}
+	skip_whitespace(c);
+	if(rad_parse_functions[i].operation == POW){
+		if(**c != ','){
+			rad_discard(operand0);
+			return NULL;
+		}
+		++*c;
+		operand1 = rad_parse_internal(c, num_args);
+		if(operand1 == NULL){
+			rad_discard(operand0);
+			return NULL;
+		}
+		skip_whitespace(c);
+	}
+	if(**c != ')'){
+		rad_discard(operand0);
+		if(operand1 != NULL){
+			rad_discard(operand1);
+		}
+		return NULL;
+	}
+	++*c;
+
+	output = rad_create_func(rad_parse_functions[i].operation, 1);
+	output->operand0 = operand0;
+	output->operand1 = operand1;
+
+	return output;
+}
+
 static rad_func *rad_parse_value(const char **c, unsigned int *num_args){
 	char *end;
 	double const_value;
@@ -79,6 +156,8 @@ static rad_func *rad_parse_value(const char **c, unsigned int *num_args){
 		}
 		++*c;
 		return output;
+	} else if((**c >= 'a' && **c <= 'z') || (**c >= 'A' && **c <= 'Z')){
+		return rad_parse_call(c, num_args);
 	} else {
 		return NULL;
 	}
@@ -105,7 +184,7 @@ static rad_func *rad_parse_recursive(const char **c, rad_func *value0, int order
 	rad_func *operation_func;
 
 	skip_whitespace(c);
-	if(**c == '\0' || **c == ')'){
+	if(**c == '\0' || **c == ')' || **c == ','){
 		return value0;
 	}
 	operation = rad_parse_operation(c);
@@ -127,7 +206,7 @@ static rad_func *rad_parse_recursive(const char **c, rad_func *value0, int order
 		operation_func->operand1 = value1;
 		value0 = operation_func;
 		skip_whitespace(c);
-		if(**c == '\0' || **c == ')'){
+		if(**c == '\0' || **c == ')' || **c == ','){
 			return value0;
 		}
 		operation = rad_parse_operation(c);
@@ -154,25 +233,51 @@ static rad_func *rad_parse_internal(const char **c, unsigned int *num_args){
 	return output;
 }
 
+//Replaces every ARG node in a freshly parsed expression with a new reference to its argument
 static void rad_substitute_args(rad_func **func, rad_func **args){
+	rad_func ***stack;
+	rad_func **slot;
+	unsigned int stack_size;
+	unsigned int stack_capacity = 16;
 	unsigned int arg_id;
+	unsigned int i;
 
-	switch((*func)->operation){
-		case ARG:
-			arg_id = (*func)->arg_id;
-			rad_discard(*func);
-			*func = rad_copy(args[arg_id]);
-			return;
-		case ADD:
-		case SUBTRACT:
-		case MULTIPLY:
-		case DIVIDE:
-			rad_substitute_args(&((*func)->operand0), args);
-			rad_substitute_args(&((*func)->operand1), args);
-			return;
-		default:
-			return;
+	stack = malloc(sizeof(rad_func **)*stack_capacity);
+	stack[0] = func;
+	stack_size = 1;
+	while(stack_size){
+		slot = stack[--stack_size];
+		switch((*slot)->operation){
+			case ARG:
+				arg_id = (*slot)->arg_id;
+				rad_discard(*slot);
+				*slot = rad_copy(args[arg_id]);
+				break;
+			case ADD:
+			case SUBTRACT:
+			case MULTIPLY:
+			case DIVIDE:
+			case POW:
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				if(stack_size + 2 > stack_capacity){
+					stack_capacity *= 2;
+					stack = realloc(stack, sizeof(rad_func **)*stack_capacity);
+				}
+				for(i = rad_num_children(*slot); i-- > 0;){
+					stack[stack_size++] = rad_child_pointer(*slot, i);
+				}
+				break;
+			default:
+				break;
+		}
 	}
+	free(stack);
 }
 
 rad_func *rad_parse(const char *c, ...){
@@ -208,45 +313,91 @@ rad_func *rad_parse(const char *c, ...){
 	return output;
 }
 
+//Printing works through an explicit stack of pending nodes and text, which is pushed in reverse order
+typedef struct rad_print_item rad_print_item;
+
+struct rad_print_item{
+	rad_func *func;
+	const char *text;
+};
+
 void rad_print(rad_func *func){
-	switch(func->operation){
-		case CONSTANT:
-			printf("%lf", func->const_value);
-			return;
-		case INPUT:
-			printf("[%u]", func->input_id);
-			return;
-		case ADD:
-			printf("(");
-			rad_print(func->operand0);
-			printf("+");
-			rad_print(func->operand1);
-			printf(")");
-			return;
-		case SUBTRACT:
-			printf("(");
-			rad_print(func->operand0);
-			printf("-");
-			rad_print(func->operand1);
-			printf(")");
-			return;
-		case MULTIPLY:
-			printf("(");
-			rad_print(func->operand0);
-			printf("*");
-			rad_print(func->operand1);
-			printf(")");
-			return;
-		case DIVIDE:
+	rad_print_item *stack;
+	rad_print_item item;
+	const char *separator;
+	unsigned int stack_size;
+	unsigned int stack_capacity = 16;
+	unsigned int i;
+
+	stack = malloc(sizeof(rad_print_item)*stack_capacity);
+	stack[0] = (rad_print_item) {.func = func, .text = NULL};
+	stack_size = 1;
+	while(stack_size){
+		item = stack[--stack_size];
+		if(item.func == NULL){
+			printf("%s", item.text);
+			continue;
+		}
+		if(stack_size + 5 > stack_capacity){
+			stack_capacity *= 2;
+			stack = realloc(stack, sizeof(rad_print_item)*stack_capacity);
+		}
+
+		func = item.func;
+		separator = NULL;
+		switch(func->operation){
+			case CONSTANT:
+				printf("%lf", func->const_value);
+				break;
+			case INPUT:
+				printf("[%u]", func->input_id);
+				break;
+			case ADD:
+				separator = "+";
+				break;
+			case SUBTRACT:
+				separator = "-";
+				break;
+			case MULTIPLY:
+				separator = "*";
+				break;
+			case DIVIDE:
+				separator = "/";
+				break;
+			case POW:
+				printf("pow(");
+				stack[stack_size++] = (rad_print_item) {.func = NULL, .text = ")"};
+				stack[stack_size++] = (rad_print_item) {.func = func->operand1, .text = NULL};
+				stack[stack_size++] = (rad_print_item) {.func = NULL, .text = ", "};
+				stack[stack_size++] = (rad_print_item) {.func = func->operand0, .text = NULL};
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				for(i = 0; i < sizeof(rad_parse_functions)/sizeof(rad_parse_functions[0]); i++){
+					if(rad_parse_functions[i].operation == func->operation){
+						printf("%s(", rad_parse_functions[i].name);
+					}
+				}
+				stack[stack_size++] = (rad_print_item) {.func = NULL, .text = ")"};
+				stack[stack_size++] = (rad_print_item) {.func = func->operand0, .text = NULL};
+				break;
+			default:
+				break;
+		}
+		if(separator != NULL){
 			printf("(");
-			rad_print(func->operand0);
-			printf("/");
-			rad_print(func->operand1);
-			printf(")");
-			return;
-		default:
-			return;
+			stack[stack_size++] = (rad_print_item) {.func = NULL, .text = ")"};
+			stack[stack_size++] = (rad_print_item) {.func = func->operand1, .text = NULL};
+			stack[stack_size++] = (rad_print_item) {.func = NULL, .text = separator};
+			stack[stack_size++] = (rad_print_item) {.func = func->operand0, .text = NULL};
+		}
 	}
+	free(stack);
 }
 
 double custom_exp2(double *input, double *grad){
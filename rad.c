@@ -1,17 +1,188 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "rad.h"
+#include "rad_internal.h"
+
+#ifdef RAD_PROFILE
+#include <time.h>
+
+rad_profile_counters rad_profile_data;
+
+static unsigned long rad_profile_nanoseconds(void){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec*1000000000UL + t.tv_nsec;
+}
+#endif
+
+//Each evaluation stamps the nodes it visits with a fresh invocation id, so shared nodes are only evaluated once per call.
+//Ids are never reused, even by different threads, so a node evaluated by one thread and then another is not mistaken
+//for one already visited. Each thread takes ids in blocks from the shared counter, so its own ids increase.
+#define RAD_INVOCATION_BLOCK 4096
+
+static atomic_ulong rad_invocation_counter = 0;
+static _Thread_local unsigned long rad_next_invocation = 0;
+static _Thread_local unsigned long rad_invocation_limit = 0;
+
+//The state below belongs to the thread which evaluates, so different functions may be evaluated by different threads
+//at the same time. Its buffers are freed when the thread exits.
+static pthread_once_t rad_thread_once = PTHREAD_ONCE_INIT;
+static pthread_key_t rad_thread_key;
+static _Thread_local bool rad_thread_registered = false;
+
+//Nodes of the current evaluation in post-order. Nested evaluations of compositions push onto the end and pop back off.
+static _Thread_local rad_func **rad_order_nodes = NULL;
+static _Thread_local unsigned int rad_order_num_nodes = 0;
+static _Thread_local unsigned int rad_order_capacity = 0;
+
+//Work stack of the graph traversals below RAD_RECURSION_DEPTH. An entry with its low bit set is a node whose children
+//have been pushed, so it is computed when popped. Nested evaluations of compositions push their entries above those of
+//the enclosing one.
+#define RAD_RECURSION_DEPTH 256
+
+static _Thread_local rad_func **rad_visit_stack = NULL;
+static _Thread_local unsigned int rad_visit_size = 0;
+static _Thread_local unsigned int rad_visit_capacity = 0;
+
+//Evaluating a composition evaluates its function with a nested call, which overwrites the state of any node the
+//function shares with the enclosing graph. Nested traversals save the nodes computed by the traversals still running
+//before stamping them, and every call restores the nodes saved during it when it returns, so a function may be
+//composed and used directly at the same time. The arrays of compositions, custom functions and dense layers are
+//saved in rad_saved_values, num_values of them for each node.
+typedef struct rad_saved_node rad_saved_node;
+
+struct rad_saved_node{
+	rad_func *func;
+	double value;
+	double deriv;
+	unsigned long invocation_id;
+	unsigned int num_values;
+};
+
+static _Thread_local rad_saved_node *rad_saved_nodes = NULL;
+static _Thread_local unsigned int rad_num_saved_nodes = 0;
+static _Thread_local unsigned int rad_saved_capacity = 0;
+static _Thread_local double *rad_saved_values = NULL;
+static _Thread_local size_t rad_num_saved_values = 0;
+static _Thread_local size_t rad_saved_values_capacity = 0;
+
+//Invocation ids of the traversals in progress, outermost first
+static _Thread_local unsigned long *rad_active_invocations = NULL;
+static _Thread_local unsigned int rad_num_active = 0;
+static _Thread_local unsigned int rad_active_capacity = 0;
+
+enum rad_visit_mode{
+	RAD_VISIT_EVAL,
+	RAD_VISIT_FORWARD,
+	RAD_VISIT_BACKWARD
+};
+
+static unsigned long rad_new_invocation(void){
+	if(rad_next_invocation == rad_invocation_limit){
+		rad_next_invocation = atomic_fetch_add(&rad_invocation_counter, RAD_INVOCATION_BLOCK);
+		rad_invocation_limit = rad_next_invocation + RAD_INVOCATION_BLOCK;
+		//Zero marks nodes which were never evaluated
+		if(rad_next_invocation == 0){
+			rad_next_invocation++;
+		}
+	}
+
+	return rad_next_invocation++;
+}
+
+static void rad_thread_free(void *unused){
+	free(rad_order_nodes);
+	free(rad_visit_stack);
+	free(rad_saved_nodes);
+	free(rad_saved_values);
+	free(rad_active_invocations);
+}
+
+static void rad_thread_key_create(void){
+	pthread_key_create(&rad_thread_key, rad_thread_free);
+}
+
+//Arranges for the buffers of the calling thread to be freed when it exits. Called whenever a buffer grows.
+static void rad_thread_register(void){
+	if(rad_thread_registered){
+		return;
+	}
+	pthread_once(&rad_thread_once, rad_thread_key_create);
+	pthread_setspecific(rad_thread_key, &rad_thread_registered);
+	rad_thread_registered = true;
+}
 
 rad_func *rad_create_func(enum rad_oper operation, unsigned int num_references){
 	rad_func *output;
 
-	output = malloc(sizeof(rad_func));
+	output = rad_malloc(sizeof(rad_func));
 	output->operation = operation;
 	output->num_references = num_references;
+	output->invocation_id = 0;
+
+	return output;
+}
+
+//Allocates a COMPOSITION or CUSTOM node in one block together with its input, value and derivative arrays
+//Compositions keep the values and derivatives of their inputs, and custom functions also keep their gradient
+static unsigned int rad_num_input_arrays(enum rad_oper operation){
+	if(operation == CUSTOM){
+		return 3;
+	} else {
+		return 2;
+	}
+}
+
+rad_func *rad_create_func_inputs(enum rad_oper operation, unsigned int num_inputs){
+	rad_func *output;
+	double *arrays;
+	unsigned int num_arrays;
+
+	num_arrays = rad_num_input_arrays(operation);
+	output = rad_malloc(sizeof(rad_func) + (sizeof(double)*num_arrays + sizeof(rad_func *))*num_inputs);
+	output->operation = operation;
+	output->num_references = 1;
+	output->invocation_id = 0;
+	output->num_inputs = num_inputs;
+
+	arrays = (double *) (output + 1);
+	output->input_values = arrays;
+	output->input_derivatives = arrays + num_inputs;
+	if(operation == CUSTOM){
+		output->input_grad = arrays + 2*num_inputs;
+	}
+	output->inputs = (rad_func **) (arrays + num_arrays*num_inputs);
+
+	return output;
+}
+
+//Allocates a DENSE node in one block together with its input arrays and the values and derivatives of its outputs
+rad_func *rad_create_dense(unsigned int weight_base, unsigned int num_inputs, unsigned int num_outputs){
+	rad_func *output;
+	double *arrays;
+
+	output = rad_malloc(sizeof(rad_func) + (2*sizeof(double) + sizeof(rad_func *))*num_inputs + 2*sizeof(double)*num_outputs);
+	output->operation = DENSE;
+	output->num_references = 1;
+	output->invocation_id = 0;
+	output->num_inputs = num_inputs;
+	output->num_outputs = num_outputs;
+	output->weight_base = weight_base;
+
+	arrays = (double *) (output + 1);
+	output->input_values = arrays;
+	output->input_derivatives = arrays + num_inputs;
+	output->output_values = arrays + 2*num_inputs;
+	output->inputs = (rad_func **) (arrays + 2*num_inputs + 2*num_outputs);
 
 	return output;
 }
@@ -68,24 +239,65 @@ rad_func *rad_divide(rad_func *operand0, rad_func *operand1){
 	return output;
 }
 
+static rad_func *rad_unary(enum rad_oper operation, rad_func *operand0){
+	rad_func *output;
+
+	output = rad_create_func(operation, 1);
+	output->operand0 = operand0;
+	output->operand1 = NULL;
+	return output;
+}
+
+rad_func *rad_exp(rad_func *operand0){
+	return rad_unary(EXP, operand0);
+}
+
+rad_func *rad_log(rad_func *operand0){
+	return rad_unary(LOG, operand0);
+}
+
+rad_func *rad_sin(rad_func *operand0){
+	return rad_unary(SIN, operand0);
+}
+
+rad_func *rad_cos(rad_func *operand0){
+	return rad_unary(COS, operand0);
+}
+
+rad_func *rad_tanh(rad_func *operand0){
+	return rad_unary(TANH, operand0);
+}
+
+rad_func *rad_sqrt(rad_func *operand0){
+	return rad_unary(SQRT, operand0);
+}
+
+rad_func *rad_sigmoid(rad_func *operand0){
+	return rad_unary(SIGMOID, operand0);
+}
+
+rad_func *rad_pow(rad_func *operand0, rad_func *operand1){
+	rad_func *output;
+
+	output = rad_create_func(POW, 1);
+	output->operand0 = operand0;
+	output->operand1 = operand1;
+	return output;
+}
+
 rad_func *rad_composition(rad_func *func, unsigned int num_args, ...){
 	va_list args;
 	rad_func *output;
 	unsigned int i;
 
-	output = rad_create_func(COMPOSITION, 1);
+	output = rad_create_func_inputs(COMPOSITION, num_args);
 	output->func = func;
-	output->num_inputs = num_args;
-	output->inputs = malloc(sizeof(rad_func *)*num_args);
 	va_start(args, num_args);
 	for(i = 0; i < num_args; i++){
 		output->inputs[i] = va_arg(args, rad_func *);
 	}
 	va_end(args);
 
-	output->input_values = malloc(sizeof(double)*num_args);
-	output->input_derivatives = malloc(sizeof(double)*num_args);
-
 	return output;
 }
 
@@ -94,20 +306,38 @@ rad_func *rad_custom(double (*custom_eval)(double *, double *), unsigned int num
 	rad_func *output;
 	unsigned int i;
 
-	output = rad_create_func(CUSTOM, 1);
+	output = rad_create_func_inputs(CUSTOM, num_args);
 	output->custom_eval = custom_eval;
-	output->num_inputs = num_args;
-	output->inputs = malloc(sizeof(rad_func *)*num_args);
 	va_start(args, num_args);
 	for(i = 0; i < num_args; i++){
 		output->inputs[i] = va_arg(args, rad_func *);
 	}
 	va_end(args);
 
-	output->input_values = malloc(sizeof(double)*num_args);
-	output->input_derivatives = malloc(sizeof(double)*num_args);
-	output->input_grad = malloc(sizeof(double)*num_args);
+	return output;
+}
+
+//A fully connected layer computing num_outputs affine functions of the inputs. The weights are the inputs with ids
+//starting at weight_base, one row of num_inputs weights followed by a bias for each output. Consumes each function in
+//inputs, but not the array itself. The layer's own value is its first output.
+rad_func *rad_dense(unsigned int weight_base, unsigned int num_inputs, unsigned int num_outputs, rad_func **inputs){
+	rad_func *output;
+	unsigned int i;
+
+	output = rad_create_dense(weight_base, num_inputs, num_outputs);
+	for(i = 0; i < num_inputs; i++){
+		output->inputs[i] = inputs[i];
+	}
+
+	return output;
+}
+
+rad_func *rad_dense_output(rad_func *layer, unsigned int output_index){
+	rad_func *output;
 
+	output = rad_create_func(DENSE_OUTPUT, 1);
+	output->layer = layer;
+	output->output_index = output_index;
 	return output;
 }
 
@@ -117,407 +347,820 @@ rad_func *rad_copy(/*not consumed*/rad_func *func){
 }
 
 void rad_discard(rad_func *func){
+	rad_func **stack;
+	rad_func *child;
+	unsigned int stack_size;
+	unsigned int stack_capacity = 16;
+	unsigned int num_children;
 	unsigned int i;
 
-	switch(func->operation){
-		case CONSTANT:
-		case INPUT:
-		case ARG:
-			func->num_references--;
-			if(func->num_references == 0){
-				free(func);
-			}
-			return;
-		case ADD:
-		case SUBTRACT:
-		case MULTIPLY:
-		case DIVIDE:
-			func->num_references--;
-			if(func->num_references == 0){
-				rad_discard(func->operand0);
-				rad_discard(func->operand1);
-				free(func);
+	func->num_references--;
+	if(func->num_references){
+		return;
+	}
+	if(rad_num_children(func) == 0 && func->operation != COMPOSITION){
+		rad_free(func);
+		return;
+	}
+
+	stack = malloc(sizeof(rad_func *)*stack_capacity);
+	stack[0] = func;
+	stack_size = 1;
+	while(stack_size){
+		func = stack[--stack_size];
+		num_children = rad_num_children(func);
+		while(stack_size + num_children + 1 > stack_capacity){
+			stack_capacity *= 2;
+			stack = realloc(stack, sizeof(rad_func *)*stack_capacity);
+		}
+		for(i = 0; i < num_children; i++){
+			child = rad_child(func, i);
+			child->num_references--;
+			if(child->num_references == 0){
+				stack[stack_size++] = child;
 			}
-			return;
-		case COMPOSITION:
-		case CUSTOM:
-			func->num_references--;
-			if(func->num_references == 0){
-				if(func->operation == COMPOSITION){
-					rad_discard(func->func);
-				}
-				for(i = 0; i < func->num_inputs; i++){
-					rad_discard(func->inputs[i]);
-				}
-				free(func->inputs);
-				free(func->input_values);
-				free(func->input_derivatives);
-				if(func->operation == CUSTOM){
-					free(func->input_grad);
-				}
-				free(func);
+		}
+		if(func->operation == COMPOSITION){
+			func->func->num_references--;
+			if(func->func->num_references == 0){
+				stack[stack_size++] = func->func;
 			}
-			return;
+		}
+		rad_free(func);
 	}
+	free(stack);
 }
 
+//Copies every node reachable from func outside of compositions. Nodes shared within func are shared within the copy.
 rad_func *rad_deep_copy(/*not consumed*/rad_func *func){
-	unsigned int i;
+	rad_node_map map;
+	rad_func **order;
+	rad_func **copies;
+	rad_func *node;
 	rad_func *output;
+	unsigned int num_nodes;
+	unsigned int index;
+	unsigned int i;
+	unsigned int j;
 
-	output = rad_create_func(func->operation, 1);
+	rad_node_map_init(&map);
+	order = rad_topological_order(func, &num_nodes, &map);
+	copies = malloc(sizeof(rad_func *)*num_nodes);
+	for(i = 0; i < num_nodes; i++){
+		node = order[i];
+		if(node->operation == COMPOSITION || node->operation == CUSTOM){
+			output = rad_create_func_inputs(node->operation, node->num_inputs);
+		} else if(node->operation == DENSE){
+			output = rad_create_dense(node->weight_base, node->num_inputs, node->num_outputs);
+		} else {
+			output = rad_create_func(node->operation, 1);
+		}
 
-	switch(func->operation){
-		case ADD:
-		case SUBTRACT:
-		case MULTIPLY:
-		case DIVIDE:
-			output->operand0 = rad_deep_copy(func->operand0);
-			output->operand1 = rad_deep_copy(func->operand1);
-			return output;
-		case CONSTANT:
-			output->const_value = func->const_value;
-			return output;
-		case INPUT:
-			output->input_id = func->input_id;
-			return output;
-		case ARG:
-			output->arg_id = func->arg_id;
-			return output;
-		case COMPOSITION:
-		case CUSTOM:
-			if(func->operation == COMPOSITION){
-				output->func = func->func;
-			} else if(func->operation == CUSTOM){
-				output->custom_eval = func->custom_eval;
-			}
-			output->num_inputs = func->num_inputs;
-			output->inputs = malloc(sizeof(rad_func *)*func->num_inputs);
-			for(i = 0; i < func->num_inputs; i++){
-				output->inputs[i] = rad_deep_copy(func->inputs[i]);
-			}
-			output->input_values = malloc(sizeof(double)*func->num_inputs);
-			output->input_derivatives = malloc(sizeof(double)*func->num_inputs);
-			return output;
-		default:
-			return NULL;
+		switch(node->operation){
+			case ADD:
+			case SUBTRACT:
+			case MULTIPLY:
+			case DIVIDE:
+			case POW:
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				output->operand0 = NULL;
+				output->operand1 = NULL;
+				for(j = 0; j < rad_num_children(node); j++){
+					rad_node_map_get(&map, rad_child(node, j), &index);
+					*rad_child_pointer(output, j) = rad_copy(copies[index]);
+				}
+				break;
+			case CONSTANT:
+				output->const_value = node->const_value;
+				break;
+			case INPUT:
+				output->input_id = node->input_id;
+				break;
+			case ARG:
+				output->arg_id = node->arg_id;
+				break;
+			case DENSE_OUTPUT:
+				rad_node_map_get(&map, node->layer, &index);
+				output->layer = rad_copy(copies[index]);
+				output->output_index = node->output_index;
+				break;
+			case COMPOSITION:
+			case CUSTOM:
+			case DENSE:
+				if(node->operation == COMPOSITION){
+					output->func = rad_copy(node->func);
+				} else if(node->operation == CUSTOM){
+					output->custom_eval = node->custom_eval;
+				}
+				for(j = 0; j < node->num_inputs; j++){
+					rad_node_map_get(&map, node->inputs[j], &index);
+					output->inputs[j] = rad_copy(copies[index]);
+				}
+				break;
+		}
+		copies[i] = output;
 	}
-}
-
-double rad_eval(rad_func *func, double *inputs){
-	double input0;
-	double input1;
-	double output;
-	int i;
 
-	switch(func->operation){
-		case ADD:
-		case SUBTRACT:
-		case MULTIPLY:
-		case DIVIDE:
-			input0 = rad_eval(func->operand0, inputs);
-			input1 = rad_eval(func->operand1, inputs);
-			break;
-		case COMPOSITION:
-		case CUSTOM:
-			for(i = 0; i < func->num_inputs; i++){
-				func->input_values[i] = rad_eval(func->inputs[i], inputs);
-			}
-			break;
-		default:
-			break;
+	output = copies[num_nodes - 1];
+	for(i = 0; i + 1 < num_nodes; i++){
+		rad_discard(copies[i]);
 	}
+	free(copies);
+	free(order);
+	rad_node_map_free(&map);
+
+	return output;
+}
+
+//Computes the value of a node whose children already hold their values. In reverse mode, compositions and custom
+//functions also store the partial derivatives by each of their inputs.
+static void rad_eval_node(rad_func *func, double *inputs, bool backward){
+	unsigned int i;
 
 	switch(func->operation){
 		case CONSTANT:
-			output = func->const_value;
+			func->value = func->const_value;
 			break;
 		case INPUT:
-			output = inputs[func->input_id];
+			func->value = inputs[func->input_id];
 			break;
 		case ADD:
-			output = input0 + input1;
+			func->value = func->operand0->value + func->operand1->value;
 			break;
 		case SUBTRACT:
-			output = input0 - input1;
+			func->value = func->operand0->value - func->operand1->value;
 			break;
 		case MULTIPLY:
-			output = input0*input1;
+			func->value = func->operand0->value*func->operand1->value;
 			break;
 		case DIVIDE:
-			output = input0/input1;
-			break;
-		case COMPOSITION:
-			output = rad_eval(func->func, func->input_values);
+			func->value = func->operand0->value/func->operand1->value;
 			break;
-		case CUSTOM:
-			output = func->custom_eval(func->input_values, func->input_derivatives);
+		case POW:
+			func->value = pow(func->operand0->value, func->operand1->value);
 			break;
-		default:
-			break;
-	}
-
-	func->value = output;
-
-	return output;
-}
-
-static double rad_backward_diff_eval(rad_func *func, double *inputs){
-	double input0;
-	double input1;
-	//rad_func *new_func;
-	int i;
-
-	switch(func->operation){
-		case ADD:
-		case SUBTRACT:
-		case MULTIPLY:
-		case DIVIDE:
-			input0 = rad_backward_diff_eval(func->operand0, inputs);
-			input1 = rad_backward_diff_eval(func->operand1, inputs);
+		case EXP:
+		case LOG:
+		case SIN:
+		case COS:
+		case TANH:
+		case SQRT:
+		case SIGMOID:
+			func->value = rad_unary_eval(func->operation, func->operand0->value);
 			break;
 		case COMPOSITION:
+			for(i = 0; i < func->num_inputs; i++){
+				func->input_values[i] = func->inputs[i]->value;
+				func->input_derivatives[i] = 0;
+			}
+			if(backward){
+				func->value = rad_backward_diff(func->func, func->input_values, func->input_derivatives);
+			} else {
+				func->value = rad_eval(func->func, func->input_values);
+			}
+			break;
 		case CUSTOM:
 			for(i = 0; i < func->num_inputs; i++){
-				func->input_values[i] = rad_backward_diff_eval(func->inputs[i], inputs);
+				func->input_values[i] = func->inputs[i]->value;
 				func->input_derivatives[i] = 0;
 			}
+			func->value = func->custom_eval(func->input_values, func->input_derivatives);
+			break;
+		case DENSE:
+			for(i = 0; i < func->num_inputs; i++){
+				func->input_values[i] = func->inputs[i]->value;
+			}
+			rad_dense_eval(func, inputs + func->weight_base);
+			func->value = func->output_values[0];
+			if(backward){
+				memset(func->output_values + func->num_outputs, 0, sizeof(double)*func->num_outputs);
+			}
+			break;
+		case DENSE_OUTPUT:
+			func->value = func->layer->output_values[func->output_index];
 			break;
 		default:
 			break;
 	}
 
+	if(backward){
+		func->deriv = 0;
+	}
+}
+
+
+//Computes the value and directional derivative of a node whose children already hold theirs. The tangent of each
+//input is taken from derivatives, or if derivatives is NULL, is one for input_id and zero for the other inputs.
+static void rad_forward_node(rad_func *func, double *inputs, double *derivatives, unsigned int input_id){
+	rad_func *operand0;
+	rad_func *operand1;
+	unsigned int i;
+
+	operand0 = func->operand0;
+	operand1 = func->operand1;
 	switch(func->operation){
 		case CONSTANT:
 			func->value = func->const_value;
+			func->deriv = 0;
 			break;
 		case INPUT:
 			func->value = inputs[func->input_id];
+			if(derivatives != NULL){
+				func->deriv = derivatives[func->input_id];
+			} else {
+				func->deriv = (func->input_id == input_id);
+			}
 			break;
 		case ADD:
-			func->value = input0 + input1;
+			func->value = operand0->value + operand1->value;
+			func->deriv = operand0->deriv + operand1->deriv;
 			break;
 		case SUBTRACT:
-			func->value = input0 - input1;
+			func->value = operand0->value - operand1->value;
+			func->deriv = operand0->deriv - operand1->deriv;
 			break;
 		case MULTIPLY:
-			func->value = input0*input1;
+			func->value = operand0->value*operand1->value;
+			func->deriv = operand0->value*operand1->deriv + operand1->value*operand0->deriv;
 			break;
 		case DIVIDE:
-			func->value = input0/input1;
+			func->value = operand0->value/operand1->value;
+			func->deriv = (operand0->deriv*operand1->value - operand1->deriv*operand0->value)/(operand1->value*operand1->value);
+			break;
+		case POW:
+			func->value = pow(operand0->value, operand1->value);
+			func->deriv = operand0->deriv*rad_pow_deriv0(operand0->value, operand1->value);
+			if(operand1->deriv != 0){
+				func->deriv += operand1->deriv*rad_pow_deriv1(operand0->value, func->value);
+			}
+			break;
+		case EXP:
+		case LOG:
+		case SIN:
+		case COS:
+		case TANH:
+		case SQRT:
+		case SIGMOID:
+			func->value = rad_unary_eval(func->operation, operand0->value);
+			func->deriv = operand0->deriv*rad_unary_deriv(func->operation, operand0->value, func->value);
 			break;
 		case COMPOSITION:
-			//This actually doesn't work...
-			/*if(func->func->invocation_id == invocation_id){
-				new_func = rad_deep_copy(func->func);
-				rad_discard(func->func);
-				func->func = new_func;
-			}*/
-			func->value = rad_backward_diff(func->func, func->input_values, func->input_derivatives);
+			for(i = 0; i < func->num_inputs; i++){
+				func->input_values[i] = func->inputs[i]->value;
+				func->input_derivatives[i] = func->inputs[i]->deriv;
+			}
+			func->deriv = rad_forward_grad(func->func, func->input_values, func->input_derivatives, &func->value);
 			break;
 		case CUSTOM:
-			func->value = func->custom_eval(func->input_values, func->input_derivatives);
+			for(i = 0; i < func->num_inputs; i++){
+				func->input_values[i] = func->inputs[i]->value;
+				func->input_derivatives[i] = func->inputs[i]->deriv;
+			}
+			func->value = func->custom_eval(func->input_values, func->input_grad);
+			func->deriv = 0;
+			for(i = 0; i < func->num_inputs; i++){
+				func->deriv += func->input_derivatives[i]*func->input_grad[i];
+			}
+			break;
+		case DENSE:
+			for(i = 0; i < func->num_inputs; i++){
+				func->input_values[i] = func->inputs[i]->value;
+				func->input_derivatives[i] = func->inputs[i]->deriv;
+			}
+			rad_dense_eval(func, inputs + func->weight_base);
+			rad_dense_tangent(func, inputs + func->weight_base, derivatives != NULL ? derivatives + func->weight_base : NULL, input_id);
+			func->value = func->output_values[0];
+			func->deriv = func->output_values[func->num_outputs];
+			break;
+		case DENSE_OUTPUT:
+			func->value = func->layer->output_values[func->output_index];
+			func->deriv = func->layer->output_values[func->layer->num_outputs + func->output_index];
 			break;
 		default:
 			break;
 	}
-
-	return func->value;
 }
 
-double rad_forward_grad(rad_func *func, double *inputs, double *derivatives, double *value){
-	unsigned int i;
-	double value0;
-	double deriv0;
-	double value1;
-	double deriv1;
-	double out_value = 0;
-	double out_deriv = 0;
-
+//The number of doubles in the arrays allocated with a node, which start at input_values
+static unsigned int rad_num_node_values(rad_func *func){
 	switch(func->operation){
-		case ADD:
-		case SUBTRACT:
-		case MULTIPLY:
-		case DIVIDE:
-			deriv0 = rad_forward_grad(func->operand0, inputs, derivatives, &value0);
-			deriv1 = rad_forward_grad(func->operand1, inputs, derivatives, &value1);
-			break;
 		case COMPOSITION:
 		case CUSTOM:
-			for(i = 0; i < func->num_inputs; i++){
-				func->input_derivatives[i] = rad_forward_grad(func->inputs[i], inputs, derivatives, func->input_values + i);
-			}
-			break;
+			return rad_num_input_arrays(func->operation)*func->num_inputs;
+		case DENSE:
+			return 2*(func->num_inputs + func->num_outputs);
 		default:
-			break;
+			return 0;
 	}
+}
 
-	switch(func->operation){
-		case CONSTANT:
-			out_value = func->const_value;
-			out_deriv = 0;
-			break;
-		case INPUT:
-			out_value = inputs[func->input_id];
-			out_deriv = derivatives[func->input_id];
-			break;
-		case ADD:
-			out_value = value0 + value1;
-			out_deriv = deriv0 + deriv1;
-			break;
-		case SUBTRACT:
-			out_value = value0 - value1;
-			out_deriv = deriv0 - deriv1;
-			break;
-		case MULTIPLY:
-			out_value = value0*value1;
-			out_deriv = value0*deriv1 + value1*deriv0;
-			break;
-		case DIVIDE:
-			out_value = value0/value1;
-			out_deriv = (deriv0*value1 - deriv1*value0)/(value1*value1);
+static void rad_restore_nodes(unsigned int saved){
+	rad_saved_node *node;
+
+	while(rad_num_saved_nodes > saved){
+		rad_num_saved_nodes--;
+		node = rad_saved_nodes + rad_num_saved_nodes;
+		node->func->value = node->value;
+		node->func->deriv = node->deriv;
+		node->func->invocation_id = node->invocation_id;
+		if(node->num_values){
+			rad_num_saved_values -= node->num_values;
+			memcpy(node->func->input_values, rad_saved_values + rad_num_saved_values, sizeof(double)*node->num_values);
+		}
+	}
+}
+
+//Saves a node before a nested traversal stamps it, if an enclosing traversal has computed it. The ids of the
+//traversals in progress increase inwards, and ids between them belong to nested traversals which have finished.
+static void rad_save_node(rad_func *func){
+	rad_saved_node *node;
+	unsigned int i;
+
+	for(i = rad_num_active - 1; i-- > 0 && rad_active_invocations[i] > func->invocation_id;);
+	if(i == UINT_MAX || rad_active_invocations[i] != func->invocation_id){
+		return;
+	}
+	if(rad_num_saved_nodes == rad_saved_capacity){
+		rad_saved_capacity = rad_saved_capacity ? 2*rad_saved_capacity : 64;
+		rad_thread_register();
+		rad_saved_nodes = realloc(rad_saved_nodes, sizeof(rad_saved_node)*rad_saved_capacity);
+	}
+	node = rad_saved_nodes + rad_num_saved_nodes;
+	node->func = func;
+	node->value = func->value;
+	node->deriv = func->deriv;
+	node->invocation_id = func->invocation_id;
+	node->num_values = rad_num_node_values(func);
+	if(node->num_values){
+		if(rad_num_saved_values + node->num_values > rad_saved_values_capacity){
+			rad_saved_values_capacity = 2*(rad_num_saved_values + node->num_values);
+			rad_thread_register();
+			rad_saved_values = realloc(rad_saved_values, sizeof(double)*rad_saved_values_capacity);
+		}
+		memcpy(rad_saved_values + rad_num_saved_values, func->input_values, sizeof(double)*node->num_values);
+		rad_num_saved_values += node->num_values;
+	}
+	rad_num_saved_nodes++;
+}
+
+static void rad_visit_reserve(unsigned int size){
+	if(size > rad_visit_capacity){
+		rad_visit_capacity = 2*size > 64 ? 2*size : 64;
+		rad_thread_register();
+		rad_visit_stack = realloc(rad_visit_stack, sizeof(rad_func *)*rad_visit_capacity);
+	}
+}
+
+static inline void rad_compute_node(rad_func *func, enum rad_visit_mode mode, double *inputs, double *derivatives, unsigned int input_id){
+	switch(mode){
+		case RAD_VISIT_EVAL:
+			rad_eval_node(func, inputs, false);
 			break;
-		case COMPOSITION:
-			out_deriv = rad_forward_grad(func->func, func->input_values, func->input_derivatives, &out_value);
+		case RAD_VISIT_FORWARD:
+			rad_forward_node(func, inputs, derivatives, input_id);
 			break;
-		case CUSTOM:
-			out_value = func->custom_eval(func->input_values, func->input_grad);
-			out_deriv = 0;
-			for(i = 0; i < func->num_inputs; i++){
-				out_deriv += func->input_derivatives[i]*func->input_grad[i];
+		case RAD_VISIT_BACKWARD:
+			rad_eval_node(func, inputs, true);
+			if(rad_order_num_nodes == rad_order_capacity){
+				rad_order_capacity = rad_order_capacity ? 2*rad_order_capacity : 64;
+				rad_thread_register();
+				rad_order_nodes = realloc(rad_order_nodes, sizeof(rad_func *)*rad_order_capacity);
 			}
-			break;
-		default:
+			rad_order_nodes[rad_order_num_nodes] = func;
+			rad_order_num_nodes++;
 			break;
 	}
+}
 
-	func->value = out_value;
-	func->deriv = out_deriv;
+static inline void rad_visit_node(rad_func *func, enum rad_visit_mode mode, double *inputs, double *derivatives, unsigned int input_id){
+#ifdef RAD_PROFILE
+	unsigned long start;
 
-	if(value != NULL){
-		*value = out_value;
+	rad_profile_add(rad_profile_data.visits + func->operation, 1);
+	if(func->operation == COMPOSITION || func->operation == CUSTOM){
+		start = rad_profile_nanoseconds();
+		rad_compute_node(func, mode, inputs, derivatives, input_id);
+		if(func->operation == COMPOSITION){
+			rad_profile_add(&rad_profile_data.composition_calls, 1);
+			rad_profile_add(&rad_profile_data.composition_nanoseconds, rad_profile_nanoseconds() - start);
+		} else {
+			rad_profile_add(&rad_profile_data.custom_calls, 1);
+			rad_profile_add(&rad_profile_data.custom_nanoseconds, rad_profile_nanoseconds() - start);
+		}
+		return;
 	}
+#endif
+	rad_compute_node(func, mode, inputs, derivatives, input_id);
+}
 
-	return out_deriv;
+//One call of rad_traverse. Nodes stamped with an id at most parent_id may belong to an enclosing traversal.
+typedef struct rad_traversal rad_traversal;
+
+struct rad_traversal{
+	enum rad_visit_mode mode;
+	double *inputs;
+	double *derivatives;
+	unsigned int input_id;
+	unsigned long invocation_id;
+	unsigned long parent_id;
+	bool nested;
+};
+
+//Stamps a node with the id of the traversal, saving it first if an enclosing traversal computed it
+static inline void rad_stamp_node(rad_func *func, rad_traversal *traversal){
+	//Nodes stamped after the enclosing traversal started were computed by finished nested traversals
+	if(traversal->nested && func->invocation_id <= traversal->parent_id){
+		rad_save_node(func);
+	}
+	func->invocation_id = traversal->invocation_id;
 }
 
-double rad_forward_diff(rad_func *func, double *inputs, unsigned int input_id, double *value){
+//Visits the nodes reachable from func depth first with the work stack, computing each node once all of its children
+//are done. Used below the depth at which rad_traverse_recursive stops, so the depth is limited only by memory.
+static void rad_traverse_stack(rad_func *func, rad_traversal *traversal){
+	rad_func **stack;
+	rad_func **children;
+	rad_func *child;
+	unsigned int num_children;
+	unsigned int base;
+	unsigned int size;
+	unsigned int first_child;
 	unsigned int i;
-	double value0;
-	double deriv0;
-	double value1;
-	double deriv1;
-	double out_value = 0;
-	double out_deriv = 0;
 
-	switch(func->operation){
-		case ADD:
-		case SUBTRACT:
-		case MULTIPLY:
-		case DIVIDE:
-			deriv0 = rad_forward_diff(func->operand0, inputs, input_id, &value0);
-			deriv1 = rad_forward_diff(func->operand1, inputs, input_id, &value1);
-			break;
-		case COMPOSITION:
-		case CUSTOM:
-			for(i = 0; i < func->num_inputs; i++){
-				func->input_derivatives[i] = rad_forward_diff(func->inputs[i], inputs, input_id, func->input_values + i);
+	base = rad_visit_size;
+	rad_visit_reserve(base + 1);
+	stack = rad_visit_stack;
+	stack[base] = func;
+	size = base + 1;
+	while(size > base){
+		func = stack[--size];
+		if((uintptr_t) func&1){
+			func = (rad_func *) ((uintptr_t) func - 1);
+		} else {
+			if(func->invocation_id == traversal->invocation_id){
+#ifdef RAD_PROFILE
+				rad_profile_add(&rad_profile_data.revisits, 1);
+#endif
+				continue;
 			}
-			break;
-		default:
-			break;
+			rad_stamp_node(func, traversal);
+			switch(func->operation){
+				case CONSTANT:
+				case INPUT:
+					rad_visit_node(func, traversal->mode, traversal->inputs, traversal->derivatives, traversal->input_id);
+					continue;
+				case COMPOSITION:
+				case CUSTOM:
+				case DENSE:
+					children = func->inputs;
+					num_children = func->num_inputs;
+					break;
+				case ADD:
+				case SUBTRACT:
+				case MULTIPLY:
+				case DIVIDE:
+				case POW:
+					children = &func->operand0;
+					num_children = 2;
+					break;
+				default:
+					children = &func->operand0;
+					num_children = 1;
+					break;
+			}
+			if(size + num_children + 1 > rad_visit_capacity){
+				rad_visit_reserve(size + num_children + 1);
+				stack = rad_visit_stack;
+			}
+
+			//The node is pushed back below its unfinished children, or computed now if there are none
+			stack[size] = (rad_func *) ((uintptr_t) func + 1);
+			first_child = size + 1;
+			size = first_child;
+			for(i = num_children; i-- > 0;){
+				child = children[i];
+				if(child->invocation_id == traversal->invocation_id){
+#ifdef RAD_PROFILE
+					rad_profile_add(&rad_profile_data.revisits, 1);
+#endif
+					continue;
+				}
+				if(child->operation == CONSTANT || child->operation == INPUT){
+					rad_stamp_node(child, traversal);
+					rad_visit_node(child, traversal->mode, traversal->inputs, traversal->derivatives, traversal->input_id);
+				} else {
+					stack[size++] = child;
+				}
+			}
+			if(size > first_child){
+				continue;
+			}
+			size--;
+		}
+
+		//Compositions and custom functions may call back into RAD, which pushes above the current entries
+		if(func->operation == COMPOSITION || func->operation == CUSTOM){
+			rad_visit_size = size;
+			rad_visit_node(func, traversal->mode, traversal->inputs, traversal->derivatives, traversal->input_id);
+			stack = rad_visit_stack;
+		} else {
+			rad_visit_node(func, traversal->mode, traversal->inputs, traversal->derivatives, traversal->input_id);
+		}
 	}
+	rad_visit_size = base;
+}
+
+//Visits the nodes reachable from func depth first by recursion, which is cheaper than the work stack for shallow
+//graphs, and hands subgraphs deeper than RAD_RECURSION_DEPTH to rad_traverse_stack
+static void rad_traverse_recursive(rad_func *func, rad_traversal *traversal, unsigned int depth){
+	unsigned int i;
 
+	if(func->invocation_id == traversal->invocation_id){
+#ifdef RAD_PROFILE
+		rad_profile_add(&rad_profile_data.revisits, 1);
+#endif
+		return;
+	}
+	if(depth == RAD_RECURSION_DEPTH){
+		rad_traverse_stack(func, traversal);
+		return;
+	}
+	rad_stamp_node(func, traversal);
 	switch(func->operation){
 		case CONSTANT:
-			out_value = func->const_value;
-			out_deriv = 0;
-			break;
 		case INPUT:
-			out_value = inputs[func->input_id];
-			out_deriv = (func->input_id == input_id);
-			break;
-		case ADD:
-			out_value = value0 + value1;
-			out_deriv = deriv0 + deriv1;
-			break;
-		case SUBTRACT:
-			out_value = value0 - value1;
-			out_deriv = deriv0 - deriv1;
-			break;
-		case MULTIPLY:
-			out_value = value0*value1;
-			out_deriv = value0*deriv1 + value1*deriv0;
-			break;
-		case DIVIDE:
-			out_value = value0/value1;
-			out_deriv = (deriv0*value1 - deriv1*value0)/(value1*value1);
 			break;
 		case COMPOSITION:
-			out_deriv = rad_forward_grad(func->func, func->input_values, func->input_derivatives, &out_value);
-			break;
 		case CUSTOM:
-			out_value = func->custom_eval(func->input_values, func->input_grad);
-			out_deriv = 0;
+		case DENSE:
 			for(i = 0; i < func->num_inputs; i++){
-				out_deriv += func->input_derivatives[i]*func->input_grad[i];
+				rad_traverse_recursive(func->inputs[i], traversal, depth + 1);
 			}
 			break;
+		case ADD:
+		case SUBTRACT:
+		case MULTIPLY:
+		case DIVIDE:
+		case POW:
+			rad_traverse_recursive(func->operand0, traversal, depth + 1);
+			rad_traverse_recursive(func->operand1, traversal, depth + 1);
+			break;
 		default:
+			rad_traverse_recursive(func->operand0, traversal, depth + 1);
 			break;
 	}
+	rad_visit_node(func, traversal->mode, traversal->inputs, traversal->derivatives, traversal->input_id);
+}
+
+//Computes every node reachable from func once all of its children are done. Nodes are stamped with a fresh
+//invocation id so shared nodes are only computed once. In reverse mode, the nodes are also appended to
+//rad_order_nodes in post-order for the sweep.
+static void rad_traverse(rad_func *func, enum rad_visit_mode mode, double *inputs, double *derivatives, unsigned int input_id){
+	rad_traversal traversal;
 
-	func->value = out_value;
-	func->deriv = out_deriv;
+	traversal.mode = mode;
+	traversal.inputs = inputs;
+	traversal.derivatives = derivatives;
+	traversal.input_id = input_id;
+	traversal.invocation_id = rad_new_invocation();
+	traversal.nested = rad_num_active > 0;
+	traversal.parent_id = traversal.nested ? rad_active_invocations[rad_num_active - 1] : 0;
+	if(rad_num_active == rad_active_capacity){
+		rad_active_capacity = rad_active_capacity ? 2*rad_active_capacity : 16;
+		rad_thread_register();
+		rad_active_invocations = realloc(rad_active_invocations, sizeof(unsigned long)*rad_active_capacity);
+	}
+	rad_active_invocations[rad_num_active++] = traversal.invocation_id;
+	rad_traverse_recursive(func, &traversal, 0);
+	rad_num_active--;
+}
 
+double rad_eval(rad_func *func, double *inputs){
+	double output;
+	unsigned int saved;
+
+	saved = rad_num_saved_nodes;
+	rad_traverse(func, RAD_VISIT_EVAL, inputs, NULL, 0);
+	output = func->value;
+	rad_restore_nodes(saved);
+
+	return output;
+}
+
+static double rad_forward(rad_func *func, double *inputs, double *derivatives, unsigned int input_id, double *value){
+	double output;
+	unsigned int saved;
+
+	saved = rad_num_saved_nodes;
+	rad_traverse(func, RAD_VISIT_FORWARD, inputs, derivatives, input_id);
 	if(value != NULL){
-		*value = out_value;
+		*value = func->value;
 	}
+	output = func->deriv;
+	rad_restore_nodes(saved);
 
-	return out_deriv;
+	return output;
 }
 
-static void rad_backward_diff_recursive(rad_func *func, double deriv, double *derivatives){
+double rad_forward_grad(rad_func *func, double *inputs, double *derivatives, double *value){
+	return rad_forward(func, inputs, derivatives, 0, value);
+}
+
+double rad_forward_diff(rad_func *func, double *inputs, unsigned int input_id, double *value){
+	return rad_forward(func, inputs, NULL, input_id, value);
+}
+
+//Propagates adjoints through the nodes of one reverse mode call in reverse topological order. The outputs of a dense
+//layer are read after the layer, so their adjoints are complete when the layer is reached.
+static void rad_backward_diff_sweep(unsigned int first_node, double *inputs, double *derivatives){
+	rad_func *func;
+	double deriv;
 	unsigned int i;
+	unsigned int j;
 
-	switch(func->operation){
-		case CONSTANT:
-			return;
-		case INPUT:
-			derivatives[func->input_id] += deriv;
-			return;
-		case ADD:
-			rad_backward_diff_recursive(func->operand0, deriv, derivatives);
-			rad_backward_diff_recursive(func->operand1, deriv, derivatives);
-			return;
-		case SUBTRACT:
-			rad_backward_diff_recursive(func->operand0, deriv, derivatives);
-			rad_backward_diff_recursive(func->operand1, -deriv, derivatives);
-			return;
-		case MULTIPLY:
-			rad_backward_diff_recursive(func->operand0, deriv*func->operand1->value, derivatives);
-			rad_backward_diff_recursive(func->operand1, deriv*func->operand0->value, derivatives);
-			return;
-		case DIVIDE:
-			rad_backward_diff_recursive(func->operand0, deriv/func->operand1->value, derivatives);
-			rad_backward_diff_recursive(func->operand1, -deriv*func->operand0->value/(func->operand1->value*func->operand1->value), derivatives);
-			return;
-		case COMPOSITION:
-		case CUSTOM:
-			for(i = 0; i < func->num_inputs; i++){
-				rad_backward_diff_recursive(func->inputs[i], deriv*func->input_derivatives[i], derivatives);
-			}
-			return;
-		default:
-			return;
+	for(i = rad_order_num_nodes; i-- > first_node;){
+		func = rad_order_nodes[i];
+		deriv = func->deriv;
+		switch(func->operation){
+			case INPUT:
+				derivatives[func->input_id] += deriv;
+				break;
+			case ADD:
+				func->operand0->deriv += deriv;
+				func->operand1->deriv += deriv;
+				break;
+			case SUBTRACT:
+				func->operand0->deriv += deriv;
+				func->operand1->deriv -= deriv;
+				break;
+			case MULTIPLY:
+				func->operand0->deriv += deriv*func->operand1->value;
+				func->operand1->deriv += deriv*func->operand0->value;
+				break;
+			case DIVIDE:
+				func->operand0->deriv += deriv/func->operand1->value;
+				func->operand1->deriv += -deriv*func->operand0->value/(func->operand1->value*func->operand1->value);
+				break;
+			case POW:
+				func->operand0->deriv += deriv*rad_pow_deriv0(func->operand0->value, func->operand1->value);
+				func->operand1->deriv += deriv*rad_pow_deriv1(func->operand0->value, func->value);
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				func->operand0->deriv += deriv*rad_unary_deriv(func->operation, func->operand0->value, func->value);
+				break;
+			case COMPOSITION:
+			case CUSTOM:
+				for(j = 0; j < func->num_inputs; j++){
+					func->inputs[j]->deriv += deriv*func->input_derivatives[j];
+				}
+				break;
+			case DENSE:
+				func->output_values[func->num_outputs] += deriv;
+				memset(func->input_derivatives, 0, sizeof(double)*func->num_inputs);
+				rad_dense_backward(func, inputs + func->weight_base, derivatives + func->weight_base);
+				for(j = 0; j < func->num_inputs; j++){
+					func->inputs[j]->deriv += func->input_derivatives[j];
+				}
+				break;
+			case DENSE_OUTPUT:
+				func->layer->output_values[func->layer->num_outputs + func->output_index] += deriv;
+				break;
+			default:
+				break;
+		}
 	}
 }
 
 double rad_backward_diff(rad_func *func, double *inputs, double *derivatives){
 	double output;
+	unsigned int first_node;
+	unsigned int saved;
+
+	saved = rad_num_saved_nodes;
+	first_node = rad_order_num_nodes;
+	rad_traverse(func, RAD_VISIT_BACKWARD, inputs, NULL, 0);
+	output = func->value;
+	func->deriv = 1;
+	rad_backward_diff_sweep(first_node, inputs, derivatives);
+	rad_order_num_nodes = first_node;
+	rad_restore_nodes(saved);
 
-	output = rad_backward_diff_eval(func, inputs);
-	rad_backward_diff_recursive(func, 1, derivatives);
 	return output;
 }
 
+//Copies the counters kept since the last reset. Without RAD_PROFILE, they are all zero. Counts added by other threads
+//during the copy may be missing from some counters.
+void rad_profile_get(rad_profile *profile){
+#ifdef RAD_PROFILE
+	unsigned int i;
+
+	for(i = 0; i < RAD_NUM_OPERATIONS; i++){
+		profile->visits[i] = atomic_load_explicit(rad_profile_data.visits + i, memory_order_relaxed);
+	}
+	profile->revisits = atomic_load_explicit(&rad_profile_data.revisits, memory_order_relaxed);
+	profile->composition_calls = atomic_load_explicit(&rad_profile_data.composition_calls, memory_order_relaxed);
+	profile->composition_seconds = atomic_load_explicit(&rad_profile_data.composition_nanoseconds, memory_order_relaxed)*1e-9;
+	profile->custom_calls = atomic_load_explicit(&rad_profile_data.custom_calls, memory_order_relaxed);
+	profile->custom_seconds = atomic_load_explicit(&rad_profile_data.custom_nanoseconds, memory_order_relaxed)*1e-9;
+	profile->allocations = atomic_load_explicit(&rad_profile_data.allocations, memory_order_relaxed);
+	profile->frees = atomic_load_explicit(&rad_profile_data.frees, memory_order_relaxed);
+#else
+	memset(profile, 0, sizeof(rad_profile));
+#endif
+}
+
+void rad_profile_reset(void){
+#ifdef RAD_PROFILE
+	unsigned int i;
+
+	for(i = 0; i < RAD_NUM_OPERATIONS; i++){
+		atomic_store_explicit(rad_profile_data.visits + i, 0, memory_order_relaxed);
+	}
+	atomic_store_explicit(&rad_profile_data.revisits, 0, memory_order_relaxed);
+	atomic_store_explicit(&rad_profile_data.composition_calls, 0, memory_order_relaxed);
+	atomic_store_explicit(&rad_profile_data.composition_nanoseconds, 0, memory_order_relaxed);
+	atomic_store_explicit(&rad_profile_data.custom_calls, 0, memory_order_relaxed);
+	atomic_store_explicit(&rad_profile_data.custom_nanoseconds, 0, memory_order_relaxed);
+	atomic_store_explicit(&rad_profile_data.allocations, 0, memory_order_relaxed);
+	atomic_store_explicit(&rad_profile_data.frees, 0, memory_order_relaxed);
+#endif
+}
+
+void rad_stats(/*not consumed*/rad_func *func, rad_graph_stats *stats){
+	rad_node_map map;
+	rad_func **order;
+	rad_func *node;
+	rad_func *child;
+	double *num_paths;
+	unsigned int *depth;
+	unsigned int *num_parents;
+	unsigned int num_nodes;
+	unsigned int num_children;
+	unsigned int index;
+	unsigned int i;
+	unsigned int j;
+
+	rad_node_map_init(&map);
+	order = rad_graph_order(func, &num_nodes, &map);
+	num_paths = malloc(sizeof(double)*num_nodes);
+	depth = malloc(sizeof(unsigned int)*num_nodes);
+	num_parents = calloc(num_nodes, sizeof(unsigned int));
+
+	memset(stats, 0, sizeof(rad_graph_stats));
+	stats->num_unique_nodes = num_nodes;
+	for(i = 0; i < num_nodes; i++){
+		node = order[i];
+		num_paths[i] = 1;
+		depth[i] = 1;
+		num_children = rad_num_children(node) + (node->operation == COMPOSITION);
+		for(j = 0; j < num_children; j++){
+			if(j == rad_num_children(node)){
+				child = node->func;
+			} else {
+				child = rad_child(node, j);
+			}
+			rad_node_map_get(&map, child, &index);
+			num_paths[i] += num_paths[index];
+			if(depth[index] + 1 > depth[i]){
+				depth[i] = depth[index] + 1;
+			}
+			num_parents[index]++;
+		}
+
+		if(node->operation == COMPOSITION || node->operation == CUSTOM){
+			stats->num_bytes += sizeof(rad_func) + (sizeof(double)*rad_num_input_arrays(node->operation) + sizeof(rad_func *))*node->num_inputs;
+		} else if(node->operation == DENSE){
+			stats->num_bytes += sizeof(rad_func) + (2*sizeof(double) + sizeof(rad_func *))*node->num_inputs + 2*sizeof(double)*node->num_outputs;
+		} else {
+			stats->num_bytes += sizeof(rad_func);
+		}
+	}
+
+	stats->num_nodes = num_paths[num_nodes - 1];
+	stats->max_depth = depth[num_nodes - 1];
+	for(i = 0; i < num_nodes; i++){
+		if(num_parents[i] < RAD_STATS_FAN_OUT){
+			stats->fan_out[num_parents[i]]++;
+		} else {
+			stats->fan_out[RAD_STATS_FAN_OUT - 1]++;
+		}
+	}
+
+	free(num_paths);
+	free(depth);
+	free(num_parents);
+	free(order);
+	rad_node_map_free(&map);
+}
@@ -1,4 +1,10 @@
+#ifndef RAD_H
+#define RAD_H
+
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
 
 enum rad_oper{
 	CONSTANT,
@@ -9,9 +15,21 @@ enum rad_oper{
 	DIVIDE,
 	ARG,
 	COMPOSITION,
-	CUSTOM
+	CUSTOM,
+	EXP,
+	LOG,
+	SIN,
+	COS,
+	TANH,
+	SQRT,
+	SIGMOID,
+	POW,
+	DENSE,
+	DENSE_OUTPUT
 };
 
+#define RAD_NUM_OPERATIONS (DENSE_OUTPUT + 1)
+
 typedef struct rad_func rad_func;
 
 struct rad_func{
@@ -21,6 +39,11 @@ struct rad_func{
 			struct rad_func *operand0;
 			struct rad_func *operand1;
 		};
+		//A DENSE_OUTPUT node reads output output_index of the DENSE node in operand0
+		struct{
+			struct rad_func *layer;
+			unsigned int output_index;
+		};
 		double const_value;
 		unsigned int input_id;
 		unsigned int arg_id;
@@ -35,15 +58,187 @@ struct rad_func{
 					double (*custom_eval)(double *, double *);
 					double *input_grad;
 				};
+				//A DENSE node keeps the values of its outputs, followed by their derivatives
+				struct{
+					unsigned int num_outputs;
+					unsigned int weight_base;
+					double *output_values;
+				};
 			};
 		};
 	};
 	unsigned int num_references;
 	double value;
 	double deriv;
-	unsigned int invocation_id;
+	unsigned long invocation_id;
+};
+
+typedef struct rad_tape_op rad_tape_op;
+
+//One instruction of a compiled tape. The result of the instruction at index i is stored in slot i.
+struct rad_tape_op{
+	enum rad_oper operation;
+	unsigned int operand0;
+	unsigned int operand1;
+	union{
+		double const_value;
+		unsigned int input_id;
+		struct{
+			unsigned int num_inputs;
+			unsigned int first_input;
+			double (*custom_eval)(double *, double *);
+		};
+	};
+};
+
+typedef struct rad_tape rad_tape;
+typedef struct rad_ctx rad_ctx;
+
+//A rad_func flattened into topological order. Compositions are inlined and dense layers are expanded into scalar
+//instructions, so every operation except ARG, COMPOSITION, DENSE and DENSE_OUTPUT may appear.
+//The instructions reading slot i are users[user_start[i]] to users[user_start[i + 1] - 1], and the INPUT instructions
+//of input id j are listed the same way in input_slots.
+//ctx is the context used by the functions which take a tape, a rad_multi or a rad_jit but no context. It is NULL until
+//the first of them is called, and because they share it, they may only be called by one thread at a time per tape.
+struct rad_tape{
+	unsigned int num_ops;
+	rad_tape_op *ops;
+	unsigned int output;
+	unsigned int num_args;
+	unsigned int *args;
+	unsigned int num_inputs;
+	unsigned int max_custom_inputs;
+	unsigned int *user_start;
+	unsigned int *users;
+	unsigned int *input_start;
+	unsigned int *input_slots;
+	rad_ctx *ctx;
+};
+
+//Scratch memory for evaluating a tape. Evaluating through a context never modifies the tape, so several threads may
+//share one tape as long as each thread uses its own context.
+struct rad_ctx{
+	rad_tape *tape;
+	double *values;
+	double *adjoints;
+	double *partials;
+	double *scratch;
+	unsigned int tangent_width;
+	double *tangents;
+	double *adjoint_tangents;
+	double *partial_tangents;
+	bool valid;
+	bool *dirty;
+	unsigned int *heap;
+	unsigned int batch_capacity;
+	double *batch_values;
+	double *batch_adjoints;
+	double *batch_partials;
+	double **batch_columns;
 };
 
+typedef struct rad_csr rad_csr;
+
+//A sparse matrix in compressed sparse row form. The entries of row i are values[row_start[i]] to
+//values[row_start[i + 1] - 1], and col_index gives the column of each entry in increasing order.
+struct rad_csr{
+	unsigned int num_rows;
+	unsigned int num_cols;
+	unsigned int *row_start;
+	unsigned int *col_index;
+	double *values;
+};
+
+typedef struct rad_multi rad_multi;
+
+//Several RAD functions compiled into one tape, so that their common subexpressions are evaluated once.
+//values holds the outputs of the last evaluation. The sparsity pattern of the Jacobian and its column coloring
+//are computed by the first call to rad_jacobian_sparse and kept for later calls.
+struct rad_multi{
+	unsigned int num_outputs;
+	rad_func **funcs;
+	rad_tape *tape;
+	unsigned int *output_slots;
+	double *values;
+	rad_csr *jacobian_pattern;
+	unsigned int num_colors;
+	unsigned int *colors;
+};
+
+typedef struct rad_jit rad_jit;
+
+//A RAD function compiled to a tape and from the tape to native code. code is NULL when native code is unavailable,
+//in which case the tape is interpreted.
+struct rad_jit{
+	rad_tape *tape;
+	void *code;
+	size_t code_size;
+};
+
+typedef struct rad_checkpoint rad_checkpoint;
+
+//Reverse mode over a tape which keeps the values and adjoints of one segment of instructions at a time, and recomputes
+//each segment before its reverse sweep. Only the slots read across segments are kept for the whole call, numbered by
+//external. memory is the number of bytes resident during a call: the arrays of the tape and every buffer of the plan.
+//The segments all have one length and are recomputed once each, rather than nested as in the binomial schedules of
+//Revolve. The buffers of a chain of n instructions therefore grow with sqrt(n) at least, where Revolve could trade
+//more recomputation for less, and a graph whose values are read far from where they are computed keeps them all
+//external. The tape and external stay resident, and at about 45 bytes per instruction they are larger than the 16 bytes
+//of values and adjoints per instruction which checkpointing saves.
+struct rad_checkpoint{
+	rad_tape *tape;
+	unsigned int segment_length;
+	size_t memory;
+	unsigned int num_external;
+	unsigned int *external;
+	double *ext_values;
+	double *ext_adjoints;
+	double *values;
+	double *adjoints;
+	double *partials;
+	double *scratch;
+};
+
+typedef struct rad_profile rad_profile;
+
+//Counters kept by the graph evaluators when RAD is built with RAD_PROFILE defined. visits counts the nodes computed
+//by operation, and revisits counts the edges to nodes already computed in the same call because they are shared.
+//The time spent in compositions and custom functions is in seconds and includes nested calls. Evaluations on all
+//threads are counted. Tapes, contexts, batches, the JIT and checkpoints are not profiled, only rad_eval,
+//rad_forward_grad, rad_forward_diff, rad_backward_diff and the allocations of RAD functions.
+struct rad_profile{
+	unsigned long visits[RAD_NUM_OPERATIONS];
+	unsigned long revisits;
+	unsigned long composition_calls;
+	double composition_seconds;
+	unsigned long custom_calls;
+	double custom_seconds;
+	unsigned long allocations;
+	unsigned long frees;
+};
+
+#define RAD_STATS_FAN_OUT 16
+
+typedef struct rad_graph_stats rad_graph_stats;
+
+//The size of a RAD function including the functions it composes. num_nodes counts each node once for every path to it
+//from the root, as if shared nodes were copied, while num_unique_nodes counts each node once. fan_out[i] is the number
+//of nodes used i times within the function, with the last entry also counting nodes used more often.
+struct rad_graph_stats{
+	double num_nodes;
+	unsigned int num_unique_nodes;
+	unsigned int max_depth;
+	unsigned int fan_out[RAD_STATS_FAN_OUT];
+	size_t num_bytes;
+};
+
+typedef struct rad_arena rad_arena;
+
+void rad_set_allocator(void *(*alloc_func)(size_t, void *), void (*free_func)(void *, void *), void *userdata);
+rad_arena *rad_arena_create(size_t block_size);
+void *rad_arena_alloc(size_t size, void *userdata);
+void rad_arena_free(void *ptr, void *userdata);
+void rad_arena_destroy(rad_arena *arena);
 rad_func *rad_create_func(enum rad_oper operation, unsigned int num_references);
 rad_func *rad_const(double const_value);
 rad_func *rad_input(unsigned int input_id);
@@ -51,8 +246,22 @@ rad_func *rad_add(rad_func *operand0, rad_func *operand1);
 rad_func *rad_subtract(rad_func *operand0, rad_func *operand1);
 rad_func *rad_multiply(rad_func *operand0, rad_func *operand1);
 rad_func *rad_divide(rad_func *operand0, rad_func *operand1);
+rad_func *rad_exp(rad_func *operand0);
+rad_func *rad_log(rad_func *operand0);
+rad_func *rad_sin(rad_func *operand0);
+rad_func *rad_cos(rad_func *operand0);
+rad_func *rad_tanh(rad_func *operand0);
+rad_func *rad_sqrt(rad_func *operand0);
+rad_func *rad_sigmoid(rad_func *operand0);
+rad_func *rad_pow(rad_func *operand0, rad_func *operand1);
 rad_func *rad_composition(rad_func *func, unsigned int num_args, ...);
 rad_func *rad_custom(double (*custom_eval)(double *, double *), unsigned int num_args, ...);
+//The graph evaluators compute a dense layer with matrix-vector kernels. Tapes expand it into one multiply and add per
+//weight, so rad_compile and everything built on it, including batched evaluation, have no matrix-matrix kernel.
+//Inside a composition the weights are the composition's arguments starting at weight_base, as for INPUT nodes, and
+//rad_compile fails if there are too few of them.
+rad_func *rad_dense(unsigned int weight_base, unsigned int num_inputs, unsigned int num_outputs, rad_func **inputs);
+rad_func *rad_dense_output(rad_func *layer, unsigned int output_index);
 rad_func *rad_copy(/*not consumed*/rad_func *func);
 rad_func *rad_deep_copy(/*not consumed*/rad_func *func);
 void rad_discard(rad_func *func);
@@ -62,3 +271,61 @@ double rad_forward_diff(rad_func *func, double *inputs, unsigned int input_id, d
 double rad_backward_diff(rad_func *func, double *inputs, double *derivatives);
 rad_func *rad_parse(const char *c, ...);
 void rad_print(rad_func *func);
+unsigned int rad_cse(/*not consumed*/rad_func *func);
+rad_func *rad_simplify(rad_func *func);
+rad_func *rad_inline(rad_func *func);
+rad_tape *rad_compile(/*not consumed*/rad_func *func);
+void rad_tape_free(rad_tape *tape);
+double rad_tape_eval(rad_tape *tape, double *inputs);
+double rad_tape_backward(rad_tape *tape, double *inputs, double *derivatives);
+void rad_tape_eval_batch(rad_tape *tape, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs);
+void rad_tape_backward_batch(rad_tape *tape, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs, double *derivatives, unsigned int deriv_stride);
+rad_ctx *rad_ctx_create(/*not consumed*/rad_tape *tape);
+void rad_ctx_free(rad_ctx *ctx);
+double rad_eval_ctx(rad_ctx *ctx, double *inputs);
+double rad_backward_diff_ctx(rad_ctx *ctx, double *inputs, double *derivatives);
+double rad_eval_incremental_ctx(rad_ctx *ctx, double *inputs, unsigned int *changed, unsigned int num_changed);
+double rad_backward_diff_incremental_ctx(rad_ctx *ctx, double *inputs, unsigned int *changed, unsigned int num_changed, double *derivatives);
+double rad_tape_eval_incremental(rad_tape *tape, double *inputs, unsigned int *changed, unsigned int num_changed);
+double rad_tape_backward_incremental(rad_tape *tape, double *inputs, unsigned int *changed, unsigned int num_changed, double *derivatives);
+double rad_forward_grad_vec_ctx(rad_ctx *ctx, double *inputs, double *tangents, unsigned int num_directions, double *out_derivs);
+double rad_tape_forward_grad_vec(rad_tape *tape, double *inputs, double *tangents, unsigned int num_directions, double *out_derivs);
+double rad_forward_grad_vec(rad_func *func, double *inputs, double *tangents, unsigned int num_directions, double *out_derivs);
+void rad_eval_batch_ctx(rad_ctx *ctx, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs);
+void rad_backward_diff_batch_ctx(rad_ctx *ctx, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs, double *derivatives, unsigned int deriv_stride);
+double rad_tape_backward_parallel(rad_tape *tape, double *samples, unsigned int num_samples, unsigned int stride, double *derivatives, unsigned int num_threads);
+double rad_hvp_ctx(rad_ctx *ctx, double *inputs, double *v, double *out);
+double rad_tape_hvp(rad_tape *tape, double *inputs, double *v, double *out);
+double rad_hvp(rad_func *func, double *inputs, double *v, double *out);
+void rad_tape_hessian(rad_tape *tape, double *inputs, double *hessian, bool sparse);
+bool rad_hessian(rad_func *func, double *inputs, double *hessian, bool sparse);
+rad_multi *rad_multi_create(rad_func **funcs, unsigned int num_outputs);
+void rad_multi_free(rad_multi *multi);
+void rad_multi_eval(rad_multi *multi, double *inputs, double *outputs);
+void rad_vjp(rad_multi *multi, double *inputs, double *cotangent, double *derivatives);
+void rad_jacobian(rad_multi *multi, double *inputs, double *jacobian);
+void rad_csr_free(rad_csr *matrix);
+rad_csr *rad_jacobian_sparse(rad_multi *multi, double *inputs);
+rad_csr *rad_tape_hessian_sparse(rad_tape *tape, double *inputs);
+rad_csr *rad_hessian_sparse(rad_func *func, double *inputs);
+bool rad_eval_batch(rad_func *func, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs);
+bool rad_backward_diff_batch(rad_func *func, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs, double *derivatives, unsigned int deriv_stride);
+double rad_backward_diff_parallel(rad_func *func, double *samples, unsigned int num_samples, unsigned int stride, double *derivatives, unsigned int num_threads);
+void rad_register_custom(double (*custom_eval)(double *, double *), const char *name);
+void rad_custom_batch(double (*custom_eval)(double *, double *), void (*batch_eval)(double **inputs, double *outputs, double **partials, unsigned int n), void (*batch_vjp)(double **inputs, double *outputs, double *adjoints, double **input_adjoints, unsigned int n));
+bool rad_emit_c(/*not consumed*/rad_func *func, FILE *file, const char *name);
+rad_jit *rad_jit_create(/*not consumed*/rad_func *func);
+void rad_jit_free(rad_jit *jit);
+double rad_jit_eval(rad_jit *jit, double *inputs);
+double rad_jit_backward(rad_jit *jit, double *inputs, double *derivatives);
+double rad_jit_backward_ctx(rad_jit *jit, rad_ctx *ctx, double *inputs, double *derivatives);
+bool rad_save(/*not consumed*/rad_func *func, const char *path);
+rad_func *rad_load(const char *path);
+rad_checkpoint *rad_checkpoint_create(/*not consumed*/rad_tape *tape, size_t memory_budget);
+void rad_checkpoint_free(rad_checkpoint *checkpoint);
+double rad_checkpoint_backward(rad_checkpoint *checkpoint, double *inputs, double *derivatives);
+void rad_profile_get(rad_profile *profile);
+void rad_profile_reset(void);
+void rad_stats(/*not consumed*/rad_func *func, rad_graph_stats *stats);
+
+#endif
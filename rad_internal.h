@@ -0,0 +1,201 @@
+#ifndef RAD_INTERNAL_H
+#define RAD_INTERNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <math.h>
+#include "rad.h"
+
+void *rad_malloc(size_t size);
+void rad_free(void *ptr);
+rad_func *rad_create_func_inputs(enum rad_oper operation, unsigned int num_inputs);
+rad_func *rad_create_dense(unsigned int weight_base, unsigned int num_inputs, unsigned int num_outputs);
+void rad_dense_eval(rad_func *func, const double *weights);
+void rad_dense_tangent(rad_func *func, const double *weights, const double *weight_tangents, unsigned int input_id);
+void rad_dense_backward(rad_func *func, const double *weights, double *weight_derivs);
+
+#ifdef RAD_PROFILE
+#include <stdatomic.h>
+
+//The counters behind rad_profile. They are updated with relaxed atomic additions, so evaluations on several threads
+//add up without losing counts, and times are kept in nanoseconds.
+typedef struct rad_profile_counters rad_profile_counters;
+
+struct rad_profile_counters{
+	atomic_ulong visits[RAD_NUM_OPERATIONS];
+	atomic_ulong revisits;
+	atomic_ulong composition_calls;
+	atomic_ulong composition_nanoseconds;
+	atomic_ulong custom_calls;
+	atomic_ulong custom_nanoseconds;
+	atomic_ulong allocations;
+	atomic_ulong frees;
+};
+
+extern rad_profile_counters rad_profile_data;
+
+static inline void rad_profile_add(atomic_ulong *counter, unsigned long amount){
+	atomic_fetch_add_explicit(counter, amount, memory_order_relaxed);
+}
+#endif
+
+//Open addressing hash map from rad_func pointers to unsigned integers, used by graph passes to give each node an index
+typedef struct rad_node_map rad_node_map;
+
+struct rad_node_map{
+	unsigned int capacity;
+	unsigned int size;
+	rad_func **keys;
+	unsigned int *values;
+};
+
+void rad_node_map_init(rad_node_map *map);
+void rad_node_map_free(rad_node_map *map);
+bool rad_node_map_get(rad_node_map *map, rad_func *key, unsigned int *value);
+void rad_node_map_set(rad_node_map *map, rad_func *key, unsigned int value);
+
+static inline double rad_unary_eval(enum rad_oper operation, double input){
+	switch(operation){
+		case EXP:
+			return exp(input);
+		case LOG:
+			return log(input);
+		case SIN:
+			return sin(input);
+		case COS:
+			return cos(input);
+		case TANH:
+			return tanh(input);
+		case SQRT:
+			return sqrt(input);
+		case SIGMOID:
+			return 1/(1 + exp(-input));
+		default:
+			return input;
+	}
+}
+
+//Derivative of a unary operation, given the input and the output it produced
+static inline double rad_unary_deriv(enum rad_oper operation, double input, double output){
+	switch(operation){
+		case EXP:
+			return output;
+		case LOG:
+			return 1/input;
+		case SIN:
+			return cos(input);
+		case COS:
+			return -sin(input);
+		case TANH:
+			return 1 - output*output;
+		case SQRT:
+			return 0.5/output;
+		case SIGMOID:
+			return output*(1 - output);
+		default:
+			return 1;
+	}
+}
+
+//Second derivative of a unary operation, given the input and the output it produced
+static inline double rad_unary_deriv2(enum rad_oper operation, double input, double output){
+	switch(operation){
+		case EXP:
+			return output;
+		case LOG:
+			return -1/(input*input);
+		case SIN:
+		case COS:
+			return -output;
+		case TANH:
+			return -2*output*(1 - output*output);
+		case SQRT:
+			return -0.25/(output*output*output);
+		case SIGMOID:
+			return output*(1 - output)*(1 - 2*output);
+		default:
+			return 0;
+	}
+}
+
+//Partial derivatives of output = pow(input0, input1). The exponent partial is taken to be zero at a zero base.
+static inline double rad_pow_deriv0(double input0, double input1){
+	return input1*pow(input0, input1 - 1);
+}
+
+static inline double rad_pow_deriv1(double input0, double output){
+	if(input0 == 0){
+		return 0;
+	}
+	return output*log(input0);
+}
+
+//Second partial derivatives of output = pow(input0, input1), with the same convention at a zero base
+static inline double rad_pow_deriv00(double input0, double input1){
+	return input1*(input1 - 1)*pow(input0, input1 - 2);
+}
+
+static inline double rad_pow_deriv01(double input0, double input1){
+	if(input0 == 0){
+		return 0;
+	}
+	return pow(input0, input1 - 1)*(1 + input1*log(input0));
+}
+
+static inline double rad_pow_deriv11(double input0, double output){
+	if(input0 == 0){
+		return 0;
+	}
+	return output*log(input0)*log(input0);
+}
+
+unsigned int rad_num_children(rad_func *func);
+rad_func *rad_child(rad_func *func, unsigned int index);
+rad_func **rad_child_pointer(rad_func *func, unsigned int index);
+rad_func **rad_topological_order(rad_func *func, unsigned int *num_nodes, rad_node_map *map);
+rad_func **rad_graph_order(rad_func *func, unsigned int *num_nodes, rad_node_map *map);
+unsigned int rad_tape_operands(rad_tape *tape, rad_tape_op *op, unsigned int **operands, unsigned int *pair);
+
+//What has been registered for a custom function with rad_register_custom and rad_custom_batch. name and the batch
+//kernels are NULL if they were not registered.
+typedef struct rad_custom_entry rad_custom_entry;
+
+struct rad_custom_entry{
+	double (*custom_eval)(double *, double *);
+	char *name;
+	void (*batch_eval)(double **inputs, double *outputs, double **partials, unsigned int n);
+	void (*batch_vjp)(double **inputs, double *outputs, double *adjoints, double **input_adjoints, unsigned int n);
+};
+
+const rad_custom_entry *rad_custom_lookup(double (*custom_eval)(double *, double *));
+const char *rad_custom_name(double (*custom_eval)(double *, double *));
+double (*rad_custom_function(const char *name))(double *, double *);
+
+rad_tape *rad_compile_roots(/*not consumed*/rad_func **funcs, unsigned int num_funcs, unsigned int *output_slots);
+rad_ctx *rad_tape_ctx(rad_tape *tape);
+void rad_ctx_forward(rad_ctx *ctx, double *inputs);
+void rad_ctx_reverse(rad_ctx *ctx, unsigned int num_ops, double *derivatives);
+
+//Elementwise kernels over columns of batched values, selected at runtime for the instruction sets the CPU supports
+typedef struct rad_kernels rad_kernels;
+
+struct rad_kernels{
+	const char *name;
+	void (*add)(double *out, const double *in0, const double *in1, unsigned int n);
+	void (*subtract)(double *out, const double *in0, const double *in1, unsigned int n);
+	void (*multiply)(double *out, const double *in0, const double *in1, unsigned int n);
+	void (*divide)(double *out, const double *in0, const double *in1, unsigned int n);
+	void (*add_adjoint)(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n);
+	void (*subtract_adjoint)(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n);
+	void (*multiply_adjoint)(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n);
+	void (*divide_adjoint)(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n);
+	void (*exp_adjoint)(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n);
+	void (*log_adjoint)(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n);
+	void (*tanh_adjoint)(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n);
+	void (*sqrt_adjoint)(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n);
+	void (*sigmoid_adjoint)(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n);
+};
+
+const rad_kernels *rad_get_kernels(void);
+
+#endif
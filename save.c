@@ -0,0 +1,388 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RAD_LOAD_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//A saved graph is a header, then the nodes in topological order with the root last, then the input indices of
+//compositions, custom functions and dense layers, then the names of the custom functions. Nodes refer to each other by
+//index, so loading needs no parsing, but every record is still decoded into a new rad_func on the heap since the
+//evaluators keep their state in the nodes. Numbers are stored in the byte order of the machine which saved them.
+#define RAD_FILE_VERSION 1
+#define RAD_FILE_BYTE_ORDER 0x01020304
+
+typedef struct rad_file_header rad_file_header;
+
+struct rad_file_header{
+	char magic[4];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t num_nodes;
+	uint32_t num_inputs;
+	uint32_t names_size;
+	uint32_t reserved[2];
+};
+
+//operand0 and operand1 hold the child indices of arithmetic nodes, operand0 holds the id of INPUT and ARG nodes, and
+//DENSE_OUTPUT nodes hold the index of their layer and their output index. Compositions, custom functions and dense
+//layers have num_inputs indices starting at first_input, and extra is the index of the composed function, the offset
+//of the custom function's name or the weight base of the layer.
+typedef struct rad_file_node rad_file_node;
+
+struct rad_file_node{
+	uint32_t operation;
+	union{
+		struct{
+			uint32_t operand0;
+			uint32_t operand1;
+		};
+		struct{
+			uint32_t first_input;
+			uint32_t num_inputs;
+		};
+	};
+	uint32_t extra;
+	union{
+		double const_value;
+		uint32_t num_outputs;
+	};
+};
+
+//Writes func to path with its sharing intact. Returns false if the file cannot be written or a custom function has no
+//name registered with rad_register_custom.
+bool rad_save(/*not consumed*/rad_func *func, const char *path){
+	rad_file_header header;
+	rad_file_node *nodes;
+	rad_node_map map;
+	rad_func **order;
+	rad_func *node;
+	uint32_t *inputs;
+	char *names;
+	const char *name;
+	FILE *file;
+	bool success;
+	unsigned int num_nodes;
+	unsigned int index;
+	unsigned int i;
+	unsigned int j;
+
+	rad_node_map_init(&map);
+	order = rad_graph_order(func, &num_nodes, &map);
+
+	memset(&header, 0, sizeof(rad_file_header));
+	memcpy(header.magic, "RADG", 4);
+	header.version = RAD_FILE_VERSION;
+	header.byte_order = RAD_FILE_BYTE_ORDER;
+	header.num_nodes = num_nodes;
+	nodes = calloc(num_nodes, sizeof(rad_file_node));
+	for(i = 0; i < num_nodes; i++){
+		node = order[i];
+		if(node->operation == COMPOSITION || node->operation == CUSTOM || node->operation == DENSE){
+			header.num_inputs += node->num_inputs;
+		}
+		if(node->operation == CUSTOM){
+			name = rad_custom_name(node->custom_eval);
+			if(name == NULL){
+				free(nodes);
+				free(order);
+				rad_node_map_free(&map);
+				return false;
+			}
+			header.names_size += strlen(name) + 1;
+		}
+	}
+	inputs = malloc(sizeof(uint32_t)*(header.num_inputs + 1));
+	names = malloc(header.names_size + 1);
+
+	header.num_inputs = 0;
+	header.names_size = 0;
+	for(i = 0; i < num_nodes; i++){
+		node = order[i];
+		nodes[i].operation = node->operation;
+		switch(node->operation){
+			case CONSTANT:
+				nodes[i].const_value = node->const_value;
+				break;
+			case INPUT:
+				nodes[i].operand0 = node->input_id;
+				break;
+			case ARG:
+				nodes[i].operand0 = node->arg_id;
+				break;
+			case DENSE_OUTPUT:
+				rad_node_map_get(&map, node->layer, &index);
+				nodes[i].operand0 = index;
+				nodes[i].operand1 = node->output_index;
+				break;
+			case COMPOSITION:
+			case CUSTOM:
+			case DENSE:
+				nodes[i].first_input = header.num_inputs;
+				nodes[i].num_inputs = node->num_inputs;
+				for(j = 0; j < node->num_inputs; j++){
+					rad_node_map_get(&map, node->inputs[j], &index);
+					inputs[header.num_inputs] = index;
+					header.num_inputs++;
+				}
+				if(node->operation == COMPOSITION){
+					rad_node_map_get(&map, node->func, &index);
+					nodes[i].extra = index;
+				} else if(node->operation == DENSE){
+					nodes[i].extra = node->weight_base;
+					nodes[i].num_outputs = node->num_outputs;
+				} else {
+					name = rad_custom_name(node->custom_eval);
+					nodes[i].extra = header.names_size;
+					strcpy(names + header.names_size, name);
+					header.names_size += strlen(name) + 1;
+				}
+				break;
+			default:
+				rad_node_map_get(&map, node->operand0, &index);
+				nodes[i].operand0 = index;
+				if(rad_num_children(node) == 2){
+					rad_node_map_get(&map, node->operand1, &index);
+					nodes[i].operand1 = index;
+				}
+				break;
+		}
+	}
+
+	file = fopen(path, "wb");
+	success = file != NULL;
+	if(success){
+		success = fwrite(&header, sizeof(rad_file_header), 1, file) == 1;
+		success = success && fwrite(nodes, sizeof(rad_file_node), num_nodes, file) == num_nodes;
+		success = success && fwrite(inputs, sizeof(uint32_t), header.num_inputs, file) == header.num_inputs;
+		success = success && fwrite(names, 1, header.names_size, file) == header.names_size;
+		success = (fclose(file) == 0) && success;
+	}
+
+	free(nodes);
+	free(inputs);
+	free(names);
+	free(order);
+	rad_node_map_free(&map);
+
+	return success;
+}
+
+//Builds the graph from the saved nodes. Every child must come before its parent, and every node but the last must be
+//used, so a damaged file cannot create cycles or leak nodes. Returns NULL if the data is not a valid graph.
+static rad_func *rad_load_nodes(const unsigned char *data, size_t size){
+	const rad_file_header *header;
+	const rad_file_node *nodes;
+	const uint32_t *inputs;
+	const char *names;
+	rad_func **funcs;
+	rad_func *output;
+	double (*custom_eval)(double *, double *);
+	uint32_t index;
+	bool valid = true;
+	unsigned int num_created;
+	unsigned int i;
+	unsigned int j;
+
+	if(size < sizeof(rad_file_header)){
+		return NULL;
+	}
+	header = (const rad_file_header *) data;
+	if(memcmp(header->magic, "RADG", 4) || header->version != RAD_FILE_VERSION || header->byte_order != RAD_FILE_BYTE_ORDER || !header->num_nodes){
+		return NULL;
+	}
+	if((size - sizeof(rad_file_header))/sizeof(rad_file_node) < header->num_nodes){
+		return NULL;
+	}
+	size -= sizeof(rad_file_header) + sizeof(rad_file_node)*header->num_nodes;
+	if(size/sizeof(uint32_t) < header->num_inputs || size - sizeof(uint32_t)*header->num_inputs < header->names_size){
+		return NULL;
+	}
+	nodes = (const rad_file_node *) (header + 1);
+	inputs = (const uint32_t *) (nodes + header->num_nodes);
+	names = (const char *) (inputs + header->num_inputs);
+	if(header->names_size && names[header->names_size - 1] != '\0'){
+		return NULL;
+	}
+
+	funcs = malloc(sizeof(rad_func *)*header->num_nodes);
+	num_created = 0;
+	for(i = 0; valid && i < header->num_nodes; i++){
+		switch(nodes[i].operation){
+			case CONSTANT:
+				funcs[i] = rad_create_func(CONSTANT, 0);
+				funcs[i]->const_value = nodes[i].const_value;
+				break;
+			case INPUT:
+				funcs[i] = rad_create_func(INPUT, 0);
+				funcs[i]->input_id = nodes[i].operand0;
+				break;
+			case ARG:
+				funcs[i] = rad_create_func(ARG, 0);
+				funcs[i]->arg_id = nodes[i].operand0;
+				break;
+			case ADD:
+			case SUBTRACT:
+			case MULTIPLY:
+			case DIVIDE:
+			case POW:
+				valid = nodes[i].operand0 < i && nodes[i].operand1 < i;
+				if(valid){
+					funcs[i] = rad_create_func(nodes[i].operation, 0);
+					funcs[i]->operand0 = funcs[nodes[i].operand0];
+					funcs[i]->operand1 = funcs[nodes[i].operand1];
+					funcs[i]->operand0->num_references++;
+					funcs[i]->operand1->num_references++;
+				}
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				valid = nodes[i].operand0 < i;
+				if(valid){
+					funcs[i] = rad_create_func(nodes[i].operation, 0);
+					funcs[i]->operand0 = funcs[nodes[i].operand0];
+					funcs[i]->operand1 = NULL;
+					funcs[i]->operand0->num_references++;
+				}
+				break;
+			case DENSE_OUTPUT:
+				valid = nodes[i].operand0 < i && funcs[nodes[i].operand0]->operation == DENSE && nodes[i].operand1 < funcs[nodes[i].operand0]->num_outputs;
+				if(valid){
+					funcs[i] = rad_create_func(DENSE_OUTPUT, 0);
+					funcs[i]->layer = funcs[nodes[i].operand0];
+					funcs[i]->output_index = nodes[i].operand1;
+					funcs[i]->layer->num_references++;
+				}
+				break;
+			case COMPOSITION:
+			case CUSTOM:
+			case DENSE:
+				valid = nodes[i].first_input <= header->num_inputs && nodes[i].num_inputs <= header->num_inputs - nodes[i].first_input;
+				for(j = 0; valid && j < nodes[i].num_inputs; j++){
+					valid = inputs[nodes[i].first_input + j] < i;
+				}
+				custom_eval = NULL;
+				if(valid && nodes[i].operation == COMPOSITION){
+					valid = nodes[i].extra < i;
+				} else if(valid && nodes[i].operation == DENSE){
+					valid = nodes[i].num_outputs != 0;
+				} else if(valid){
+					valid = nodes[i].extra < header->names_size;
+					if(valid){
+						custom_eval = rad_custom_function(names + nodes[i].extra);
+						valid = custom_eval != NULL;
+					}
+				}
+				if(!valid){
+					break;
+				}
+				if(nodes[i].operation == DENSE){
+					funcs[i] = rad_create_dense(nodes[i].extra, nodes[i].num_inputs, nodes[i].num_outputs);
+				} else {
+					funcs[i] = rad_create_func_inputs(nodes[i].operation, nodes[i].num_inputs);
+				}
+				funcs[i]->num_references = 0;
+				for(j = 0; j < nodes[i].num_inputs; j++){
+					index = inputs[nodes[i].first_input + j];
+					funcs[i]->inputs[j] = funcs[index];
+					funcs[index]->num_references++;
+				}
+				if(nodes[i].operation == COMPOSITION){
+					funcs[i]->func = funcs[nodes[i].extra];
+					funcs[i]->func->num_references++;
+				} else if(nodes[i].operation == CUSTOM){
+					funcs[i]->custom_eval = custom_eval;
+				}
+				break;
+			default:
+				valid = false;
+				break;
+		}
+		if(valid){
+			num_created++;
+		}
+	}
+	for(j = 0; valid && j + 1 < header->num_nodes; j++){
+		valid = funcs[j]->num_references != 0;
+	}
+
+	if(!valid){
+		for(j = 0; j < num_created; j++){
+			rad_free(funcs[j]);
+		}
+		free(funcs);
+		return NULL;
+	}
+
+	output = funcs[header->num_nodes - 1];
+	output->num_references++;
+	free(funcs);
+
+	return output;
+}
+
+//Loads a RAD function written by rad_save, which returns a new reference. The file is mapped or read only while the nodes
+//are rebuilt from it. Custom functions are looked up by the names given to rad_register_custom. Returns NULL if the file
+//cannot be read, was written by another version or byte order, or names a custom function which is not registered.
+rad_func *rad_load(const char *path){
+	rad_func *output;
+	unsigned char *data;
+	size_t size;
+#ifdef RAD_LOAD_MMAP
+	struct stat info;
+	int descriptor;
+
+	descriptor = open(path, O_RDONLY);
+	if(descriptor < 0){
+		return NULL;
+	}
+	if(fstat(descriptor, &info) || info.st_size == 0){
+		close(descriptor);
+		return NULL;
+	}
+	size = info.st_size;
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+	if(data == MAP_FAILED){
+		return NULL;
+	}
+	output = rad_load_nodes(data, size);
+	munmap(data, size);
+#else
+	FILE *file;
+	long length;
+
+	file = fopen(path, "rb");
+	if(file == NULL){
+		return NULL;
+	}
+	if(fseek(file, 0, SEEK_END) || (length = ftell(file)) <= 0 || fseek(file, 0, SEEK_SET)){
+		fclose(file);
+		return NULL;
+	}
+	size = length;
+	data = malloc(size);
+	if(fread(data, 1, size, file) != size){
+		size = 0;
+	}
+	fclose(file);
+	output = rad_load_nodes(data, size);
+	free(data);
+#endif
+
+	return output;
+}
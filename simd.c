@@ -0,0 +1,368 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAD_X86_SIMD
+#include <immintrin.h>
+#endif
+
+//Only the arithmetic operations and the adjoints that need nothing but arithmetic on the operand and the result have
+//vector kernels. The batched forward pass computes POW and every unary operation with libm one sample at a time, and
+//the adjoints of POW, SIN and COS stay scalar loops in tape.c, because vectorizing them would need a vector math library.
+
+//The adjoint kernels update adj0 before adj1 within each vector so that they stay correct when both operands are the same slot
+
+static void rad_add_scalar(double *out, const double *in0, const double *in1, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		out[k] = in0[k] + in1[k];
+	}
+}
+
+static void rad_subtract_scalar(double *out, const double *in0, const double *in1, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		out[k] = in0[k] - in1[k];
+	}
+}
+
+static void rad_multiply_scalar(double *out, const double *in0, const double *in1, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		out[k] = in0[k]*in1[k];
+	}
+}
+
+static void rad_divide_scalar(double *out, const double *in0, const double *in1, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		out[k] = in0[k]/in1[k];
+	}
+}
+
+static void rad_add_adjoint_scalar(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k];
+		adj1[k] += adj[k];
+	}
+}
+
+static void rad_subtract_adjoint_scalar(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k];
+		adj1[k] -= adj[k];
+	}
+}
+
+static void rad_multiply_adjoint_scalar(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k]*in1[k];
+		adj1[k] += adj[k]*in0[k];
+	}
+}
+
+static void rad_divide_adjoint_scalar(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k]/in1[k];
+		adj1[k] += -adj[k]*in0[k]/(in1[k]*in1[k]);
+	}
+}
+
+//The unary adjoint kernels use the same expressions as rad_unary_deriv so that every kernel set gives identical results
+
+static void rad_exp_adjoint_scalar(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k]*out[k];
+	}
+}
+
+static void rad_log_adjoint_scalar(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k]*(1/in0[k]);
+	}
+}
+
+static void rad_tanh_adjoint_scalar(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k]*(1 - out[k]*out[k]);
+	}
+}
+
+static void rad_sqrt_adjoint_scalar(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k]*(0.5/out[k]);
+	}
+}
+
+static void rad_sigmoid_adjoint_scalar(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){
+	unsigned int k;
+
+	for(k = 0; k < n; k++){
+		adj0[k] += adj[k]*(out[k]*(1 - out[k]));
+	}
+}
+
+static const rad_kernels rad_kernels_scalar = {
+	"scalar",
+	rad_add_scalar,
+	rad_subtract_scalar,
+	rad_multiply_scalar,
+	rad_divide_scalar,
+	rad_add_adjoint_scalar,
+	rad_subtract_adjoint_scalar,
+	rad_multiply_adjoint_scalar,
+	rad_divide_adjoint_scalar,
+	rad_exp_adjoint_scalar,
+	rad_log_adjoint_scalar,
+	rad_tanh_adjoint_scalar,
+	rad_sqrt_adjoint_scalar,
+	rad_sigmoid_adjoint_scalar
+};
+
+#ifdef RAD_X86_SIMD
+
+//Defines the kernels for one instruction set. The tails shorter than one vector are handed to the scalar kernels.
+#define RAD_DEFINE_KERNELS(isa, isa_target, vec, width, vload, vstore, vadd, vsub, vmul, vdiv, vset1)\
+static __attribute__((target(isa_target))) void rad_add_##isa(double *out, const double *in0, const double *in1, unsigned int n){\
+	unsigned int k;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		vstore(out + k, vadd(vload(in0 + k), vload(in1 + k)));\
+	}\
+	rad_add_scalar(out + k, in0 + k, in1 + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_subtract_##isa(double *out, const double *in0, const double *in1, unsigned int n){\
+	unsigned int k;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		vstore(out + k, vsub(vload(in0 + k), vload(in1 + k)));\
+	}\
+	rad_subtract_scalar(out + k, in0 + k, in1 + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_multiply_##isa(double *out, const double *in0, const double *in1, unsigned int n){\
+	unsigned int k;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		vstore(out + k, vmul(vload(in0 + k), vload(in1 + k)));\
+	}\
+	rad_multiply_scalar(out + k, in0 + k, in1 + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_divide_##isa(double *out, const double *in0, const double *in1, unsigned int n){\
+	unsigned int k;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		vstore(out + k, vdiv(vload(in0 + k), vload(in1 + k)));\
+	}\
+	rad_divide_scalar(out + k, in0 + k, in1 + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_add_adjoint_##isa(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n){\
+	unsigned int k;\
+	vec a;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		a = vload(adj + k);\
+		vstore(adj0 + k, vadd(vload(adj0 + k), a));\
+		vstore(adj1 + k, vadd(vload(adj1 + k), a));\
+	}\
+	rad_add_adjoint_scalar(adj0 + k, adj1 + k, adj + k, in0 + k, in1 + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_subtract_adjoint_##isa(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n){\
+	unsigned int k;\
+	vec a;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		a = vload(adj + k);\
+		vstore(adj0 + k, vadd(vload(adj0 + k), a));\
+		vstore(adj1 + k, vsub(vload(adj1 + k), a));\
+	}\
+	rad_subtract_adjoint_scalar(adj0 + k, adj1 + k, adj + k, in0 + k, in1 + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_multiply_adjoint_##isa(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n){\
+	unsigned int k;\
+	vec a;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		a = vload(adj + k);\
+		vstore(adj0 + k, vadd(vload(adj0 + k), vmul(a, vload(in1 + k))));\
+		vstore(adj1 + k, vadd(vload(adj1 + k), vmul(a, vload(in0 + k))));\
+	}\
+	rad_multiply_adjoint_scalar(adj0 + k, adj1 + k, adj + k, in0 + k, in1 + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_divide_adjoint_##isa(double *adj0, double *adj1, const double *adj, const double *in0, const double *in1, unsigned int n){\
+	unsigned int k;\
+	vec a;\
+	vec b;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		a = vload(adj + k);\
+		b = vload(in1 + k);\
+		vstore(adj0 + k, vadd(vload(adj0 + k), vdiv(a, b)));\
+		vstore(adj1 + k, vsub(vload(adj1 + k), vdiv(vmul(a, vload(in0 + k)), vmul(b, b))));\
+	}\
+	rad_divide_adjoint_scalar(adj0 + k, adj1 + k, adj + k, in0 + k, in1 + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_exp_adjoint_##isa(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){\
+	unsigned int k;\
+\
+	for(k = 0; k + width <= n; k += width){\
+		vstore(adj0 + k, vadd(vload(adj0 + k), vmul(vload(adj + k), vload(out + k))));\
+	}\
+	rad_exp_adjoint_scalar(adj0 + k, adj + k, in0 + k, out + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_log_adjoint_##isa(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){\
+	unsigned int k;\
+	vec one;\
+\
+	one = vset1(1.0);\
+	for(k = 0; k + width <= n; k += width){\
+		vstore(adj0 + k, vadd(vload(adj0 + k), vmul(vload(adj + k), vdiv(one, vload(in0 + k)))));\
+	}\
+	rad_log_adjoint_scalar(adj0 + k, adj + k, in0 + k, out + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_tanh_adjoint_##isa(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){\
+	unsigned int k;\
+	vec one;\
+	vec o;\
+\
+	one = vset1(1.0);\
+	for(k = 0; k + width <= n; k += width){\
+		o = vload(out + k);\
+		vstore(adj0 + k, vadd(vload(adj0 + k), vmul(vload(adj + k), vsub(one, vmul(o, o)))));\
+	}\
+	rad_tanh_adjoint_scalar(adj0 + k, adj + k, in0 + k, out + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_sqrt_adjoint_##isa(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){\
+	unsigned int k;\
+	vec half;\
+\
+	half = vset1(0.5);\
+	for(k = 0; k + width <= n; k += width){\
+		vstore(adj0 + k, vadd(vload(adj0 + k), vmul(vload(adj + k), vdiv(half, vload(out + k)))));\
+	}\
+	rad_sqrt_adjoint_scalar(adj0 + k, adj + k, in0 + k, out + k, n - k);\
+}\
+\
+static __attribute__((target(isa_target))) void rad_sigmoid_adjoint_##isa(double *adj0, const double *adj, const double *in0, const double *out, unsigned int n){\
+	unsigned int k;\
+	vec one;\
+	vec o;\
+\
+	one = vset1(1.0);\
+	for(k = 0; k + width <= n; k += width){\
+		o = vload(out + k);\
+		vstore(adj0 + k, vadd(vload(adj0 + k), vmul(vload(adj + k), vmul(o, vsub(one, o)))));\
+	}\
+	rad_sigmoid_adjoint_scalar(adj0 + k, adj + k, in0 + k, out + k, n - k);\
+}\
+\
+static const rad_kernels rad_kernels_##isa = {\
+	#isa,\
+	rad_add_##isa,\
+	rad_subtract_##isa,\
+	rad_multiply_##isa,\
+	rad_divide_##isa,\
+	rad_add_adjoint_##isa,\
+	rad_subtract_adjoint_##isa,\
+	rad_multiply_adjoint_##isa,\
+	rad_divide_adjoint_##isa,\
+	rad_exp_adjoint_##isa,\
+	rad_log_adjoint_##isa,\
+	rad_tanh_adjoint_##isa,\
+	rad_sqrt_adjoint_##isa,\
+	rad_sigmoid_adjoint_##isa\
+};
+
+RAD_DEFINE_KERNELS(sse2, "sse2", __m128d, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, _mm_sub_pd, _mm_mul_pd, _mm_div_pd, _mm_set1_pd)
+RAD_DEFINE_KERNELS(avx2, "avx2", __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd, _mm256_set1_pd)
+RAD_DEFINE_KERNELS(avx512, "avx512f", __m512d, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, _mm512_sub_pd, _mm512_mul_pd, _mm512_div_pd, _mm512_set1_pd)
+
+#endif
+
+static const rad_kernels *rad_selected_kernels = NULL;
+
+//The RAD_SIMD environment variable may name a kernel set to use instead of the best one the CPU supports
+static const rad_kernels *rad_select_kernels(void){
+	const char *requested;
+
+	requested = getenv("RAD_SIMD");
+	if(requested != NULL && !strcmp(requested, "scalar")){
+		return &rad_kernels_scalar;
+	}
+
+#ifdef RAD_X86_SIMD
+	__builtin_cpu_init();
+	if(requested != NULL){
+		if(!strcmp(requested, "sse2") && __builtin_cpu_supports("sse2")){
+			return &rad_kernels_sse2;
+		} else if(!strcmp(requested, "avx2") && __builtin_cpu_supports("avx2")){
+			return &rad_kernels_avx2;
+		} else if(!strcmp(requested, "avx512") && __builtin_cpu_supports("avx512f")){
+			return &rad_kernels_avx512;
+		}
+	}
+	if(__builtin_cpu_supports("avx512f")){
+		return &rad_kernels_avx512;
+	} else if(__builtin_cpu_supports("avx2")){
+		return &rad_kernels_avx2;
+	} else if(__builtin_cpu_supports("sse2")){
+		return &rad_kernels_sse2;
+	}
+#endif
+
+	return &rad_kernels_scalar;
+}
+
+//Contexts on several threads may ask for the kernels at once, so the choice is published atomically
+const rad_kernels *rad_get_kernels(void){
+	const rad_kernels *kernels;
+
+#ifdef __GNUC__
+	kernels = __atomic_load_n(&rad_selected_kernels, __ATOMIC_ACQUIRE);
+	if(kernels == NULL){
+		kernels = rad_select_kernels();
+		__atomic_store_n(&rad_selected_kernels, kernels, __ATOMIC_RELEASE);
+	}
+#else
+	kernels = rad_selected_kernels;
+	if(kernels == NULL){
+		kernels = rad_select_kernels();
+		rad_selected_kernels = kernels;
+	}
+#endif
+
+	return kernels;
+}
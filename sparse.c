@@ -0,0 +1,570 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+//A sorted set of input ids
+typedef struct rad_index_set rad_index_set;
+
+struct rad_index_set{
+	unsigned int size;
+	unsigned int capacity;
+	unsigned int *items;
+};
+
+static void rad_index_set_union(rad_index_set *output, rad_index_set *a, rad_index_set *b){
+	unsigned int i = 0;
+	unsigned int j = 0;
+
+	output->size = 0;
+	output->capacity = a->size + b->size;
+	output->items = malloc(sizeof(unsigned int)*(output->capacity ? output->capacity : 1));
+	while(i < a->size || j < b->size){
+		if(j == b->size || (i < a->size && a->items[i] < b->items[j])){
+			output->items[output->size++] = a->items[i++];
+		} else if(i == a->size || b->items[j] < a->items[i]){
+			output->items[output->size++] = b->items[j++];
+		} else {
+			output->items[output->size++] = a->items[i++];
+			j++;
+		}
+	}
+}
+
+static void rad_index_set_push(rad_index_set *set, unsigned int item){
+	if(set->size == set->capacity){
+		set->capacity = set->capacity ? 2*set->capacity : 4;
+		set->items = realloc(set->items, sizeof(unsigned int)*set->capacity);
+	}
+	set->items[set->size++] = item;
+}
+
+static int rad_compare_index(const void *a, const void *b){
+	unsigned int x = *(const unsigned int *) a;
+	unsigned int y = *(const unsigned int *) b;
+
+	return (x > y) - (x < y);
+}
+
+//Sorts the items pushed into set and removes duplicates
+static void rad_index_set_normalize(rad_index_set *set){
+	unsigned int i;
+	unsigned int size = 0;
+
+	if(set->size == 0){
+		return;
+	}
+	qsort(set->items, set->size, sizeof(unsigned int), rad_compare_index);
+	for(i = 0; i < set->size; i++){
+		if(size == 0 || set->items[size - 1] != set->items[i]){
+			set->items[size++] = set->items[i];
+		}
+	}
+	set->size = size;
+}
+
+static void rad_free_index_sets(rad_index_set *sets, unsigned int num_sets){
+	unsigned int i;
+
+	for(i = 0; i < num_sets; i++){
+		free(sets[i].items);
+	}
+	free(sets);
+}
+
+//Finds the input ids that slots of a tape depend on. Only INPUT instructions and nonlinear instructions keep a set,
+//and an ADD, SUBTRACT or CONSTANT depends on the sets reached through its operands, which are gathered when a
+//nonlinear instruction or an output reads it. A set is freed after the last instruction reaching it, so a long sum
+//does not build a set for each partial sum.
+typedef struct rad_dependencies rad_dependencies;
+
+struct rad_dependencies{
+	rad_tape *tape;
+	rad_index_set *sets;
+	unsigned int *last_use;
+	unsigned int *stamps;
+	unsigned int stamp;
+	unsigned int *stack;
+};
+
+static bool rad_is_linear(enum rad_oper operation){
+	return operation == CONSTANT || operation == ADD || operation == SUBTRACT;
+}
+
+//Outputs are read after the last instruction, so their sets are kept until rad_dependencies_free
+static void rad_dependencies_init(rad_dependencies *dep, rad_tape *tape, unsigned int *outputs, unsigned int num_outputs){
+	rad_tape_op *op;
+	unsigned int reader;
+	unsigned int i;
+	unsigned int j;
+
+	dep->tape = tape;
+	dep->sets = calloc(tape->num_ops ? tape->num_ops : 1, sizeof(rad_index_set));
+	dep->last_use = calloc(tape->num_ops ? tape->num_ops : 1, sizeof(unsigned int));
+	dep->stamps = calloc(tape->num_ops ? tape->num_ops : 1, sizeof(unsigned int));
+	dep->stamp = 0;
+	dep->stack = malloc(sizeof(unsigned int)*(2*tape->num_ops + 1));
+	for(i = 0; i < num_outputs; i++){
+		dep->last_use[outputs[i]] = tape->num_ops;
+	}
+
+	//A linear instruction passes its readers on to its operands
+	for(i = tape->num_ops; i-- > 0;){
+		op = tape->ops + i;
+		reader = rad_is_linear(op->operation) ? dep->last_use[i] : i;
+		switch(op->operation){
+			case ADD:
+			case SUBTRACT:
+			case MULTIPLY:
+			case DIVIDE:
+			case POW:
+				if(dep->last_use[op->operand1] < reader){
+					dep->last_use[op->operand1] = reader;
+				}
+				//Fall through
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				if(dep->last_use[op->operand0] < reader){
+					dep->last_use[op->operand0] = reader;
+				}
+				break;
+			case CUSTOM:
+				for(j = 0; j < op->num_inputs; j++){
+					if(dep->last_use[tape->args[op->first_input + j]] < reader){
+						dep->last_use[tape->args[op->first_input + j]] = reader;
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+static void rad_dependencies_free(rad_dependencies *dep){
+	rad_free_index_sets(dep->sets, dep->tape->num_ops);
+	free(dep->last_use);
+	free(dep->stamps);
+	free(dep->stack);
+}
+
+//Pushes the input ids which slot depends on into set, unsorted. Slots already stamped with stamp are skipped, so
+//several slots may be gathered into one set. If reader is not UINT_MAX, the sets whose last reader it is are freed
+//instead.
+static void rad_dependencies_gather(rad_dependencies *dep, unsigned int slot, rad_index_set *set, unsigned int stamp, unsigned int reader){
+	rad_tape_op *op;
+	unsigned int size = 0;
+	unsigned int i;
+
+	dep->stack[size++] = slot;
+	while(size > 0){
+		slot = dep->stack[--size];
+		if(dep->stamps[slot] == stamp){
+			continue;
+		}
+		dep->stamps[slot] = stamp;
+		op = dep->tape->ops + slot;
+		if(op->operation == ADD || op->operation == SUBTRACT){
+			dep->stack[size++] = op->operand0;
+			dep->stack[size++] = op->operand1;
+		} else if(op->operation != CONSTANT){
+			if(reader != UINT_MAX){
+				if(dep->last_use[slot] == reader){
+					free(dep->sets[slot].items);
+					dep->sets[slot].items = NULL;
+					dep->sets[slot].size = 0;
+					dep->sets[slot].capacity = 0;
+				}
+			} else {
+				for(i = 0; i < dep->sets[slot].size; i++){
+					rad_index_set_push(set, dep->sets[slot].items[i]);
+				}
+			}
+		}
+	}
+}
+
+static unsigned int rad_dependencies_stamp(rad_dependencies *dep){
+	return ++dep->stamp;
+}
+
+//Gathers the sets of the operands of instruction i into a and, for binary instructions, b, sorted
+static void rad_dependencies_operands(rad_dependencies *dep, unsigned int i, rad_index_set *a, rad_index_set *b){
+	rad_tape_op *op;
+	unsigned int stamp;
+	unsigned int j;
+
+	op = dep->tape->ops + i;
+	a->size = 0;
+	b->size = 0;
+	if(op->operation == CUSTOM){
+		stamp = rad_dependencies_stamp(dep);
+		for(j = 0; j < op->num_inputs; j++){
+			rad_dependencies_gather(dep, dep->tape->args[op->first_input + j], a, stamp, UINT_MAX);
+		}
+	} else {
+		rad_dependencies_gather(dep, op->operand0, a, rad_dependencies_stamp(dep), UINT_MAX);
+		if(op->operation == MULTIPLY || op->operation == DIVIDE || op->operation == POW){
+			rad_dependencies_gather(dep, op->operand1, b, rad_dependencies_stamp(dep), UINT_MAX);
+		}
+	}
+	rad_index_set_normalize(a);
+	rad_index_set_normalize(b);
+}
+
+//Frees the sets whose last reader is instruction i
+static void rad_dependencies_release(rad_dependencies *dep, unsigned int i){
+	rad_tape_op *op;
+	unsigned int stamp;
+	unsigned int j;
+
+	op = dep->tape->ops + i;
+	stamp = rad_dependencies_stamp(dep);
+	if(op->operation == CUSTOM){
+		for(j = 0; j < op->num_inputs; j++){
+			rad_dependencies_gather(dep, dep->tape->args[op->first_input + j], NULL, stamp, i);
+		}
+	} else {
+		rad_dependencies_gather(dep, op->operand0, NULL, stamp, i);
+		if(op->operation == MULTIPLY || op->operation == DIVIDE || op->operation == POW){
+			rad_dependencies_gather(dep, op->operand1, NULL, stamp, i);
+		}
+	}
+	if(dep->last_use[i] <= i){
+		free(dep->sets[i].items);
+		dep->sets[i].items = NULL;
+		dep->sets[i].size = 0;
+		dep->sets[i].capacity = 0;
+	}
+}
+
+//Computes the sets of the INPUT and nonlinear instructions in order. If rows is not NULL, the pairs of inputs which
+//interact through a nonlinear instruction are pushed into the row of each. The result is conservative: an interaction
+//is kept even if it cancels out or does not reach the output.
+static void rad_dependencies_sweep(rad_dependencies *dep, rad_index_set *rows){
+	rad_tape *tape;
+	rad_tape_op *op;
+	rad_index_set a = {0, 0, NULL};
+	rad_index_set b = {0, 0, NULL};
+	rad_index_set *left;
+	rad_index_set *right;
+	unsigned int i;
+	unsigned int j;
+	unsigned int k;
+
+	tape = dep->tape;
+	for(i = 0; i < tape->num_ops; i++){
+		op = tape->ops + i;
+		if(op->operation == INPUT){
+			if(dep->last_use[i] > i){
+				rad_index_set_push(dep->sets + i, op->input_id);
+			}
+			continue;
+		}
+		if(rad_is_linear(op->operation)){
+			continue;
+		}
+		rad_dependencies_operands(dep, i, &a, &b);
+		rad_index_set_union(dep->sets + i, &a, &b);
+
+		if(rows != NULL){
+			left = NULL;
+			right = NULL;
+			switch(op->operation){
+				case MULTIPLY:
+					left = &a;
+					right = &b;
+					break;
+				case DIVIDE:
+					if(b.size){
+						left = dep->sets + i;
+						right = dep->sets + i;
+					}
+					break;
+				case POW:
+					if(b.size){
+						left = dep->sets + i;
+						right = dep->sets + i;
+					} else {
+						left = &a;
+						right = &a;
+					}
+					break;
+				default:
+					left = dep->sets + i;
+					right = dep->sets + i;
+					break;
+			}
+			if(left != NULL){
+				for(j = 0; j < left->size; j++){
+					for(k = 0; k < right->size; k++){
+						rad_index_set_push(rows + left->items[j], right->items[k]);
+						if(left != right){
+							rad_index_set_push(rows + right->items[k], left->items[j]);
+						}
+					}
+				}
+				//Keep the rows short when the same pairs are pushed repeatedly
+				for(j = 0; j < left->size; j++){
+					if(rows[left->items[j]].size > 4*tape->num_inputs){
+						rad_index_set_normalize(rows + left->items[j]);
+					}
+				}
+				for(k = 0; k < right->size; k++){
+					if(rows[right->items[k]].size > 4*tape->num_inputs){
+						rad_index_set_normalize(rows + right->items[k]);
+					}
+				}
+			}
+		}
+		rad_dependencies_release(dep, i);
+	}
+	free(a.items);
+	free(b.items);
+}
+
+static rad_csr *rad_csr_from_sets(rad_index_set *rows, unsigned int num_rows, unsigned int num_cols){
+	rad_csr *output;
+	unsigned int i;
+
+	output = malloc(sizeof(rad_csr));
+	output->num_rows = num_rows;
+	output->num_cols = num_cols;
+	output->row_start = malloc(sizeof(unsigned int)*(num_rows + 1));
+	output->row_start[0] = 0;
+	for(i = 0; i < num_rows; i++){
+		output->row_start[i + 1] = output->row_start[i] + rows[i].size;
+	}
+	output->col_index = malloc(sizeof(unsigned int)*(output->row_start[num_rows] ? output->row_start[num_rows] : 1));
+	output->values = calloc(output->row_start[num_rows] ? output->row_start[num_rows] : 1, sizeof(double));
+	for(i = 0; i < num_rows; i++){
+		memcpy(output->col_index + output->row_start[i], rows[i].items, sizeof(unsigned int)*rows[i].size);
+	}
+
+	return output;
+}
+
+void rad_csr_free(rad_csr *matrix){
+	free(matrix->row_start);
+	free(matrix->col_index);
+	free(matrix->values);
+	free(matrix);
+}
+
+//Greedy Curtis-Powell-Reid coloring: two columns get the same color only if no row has an entry in both,
+//so every entry can be recovered from the product of the matrix with the sum of the columns of one color.
+static unsigned int rad_color_columns(rad_csr *pattern, unsigned int *colors){
+	unsigned int *col_start;
+	unsigned int *col_rows;
+	unsigned int *fill;
+	unsigned int *forbidden;
+	unsigned int num_colors = 0;
+	unsigned int row;
+	unsigned int color;
+	unsigned int i;
+	unsigned int j;
+	unsigned int p;
+	unsigned int q;
+
+	col_start = calloc(pattern->num_cols + 1, sizeof(unsigned int));
+	for(p = 0; p < pattern->row_start[pattern->num_rows]; p++){
+		col_start[pattern->col_index[p] + 1]++;
+	}
+	for(j = 0; j < pattern->num_cols; j++){
+		col_start[j + 1] += col_start[j];
+	}
+	col_rows = malloc(sizeof(unsigned int)*(col_start[pattern->num_cols] ? col_start[pattern->num_cols] : 1));
+	fill = malloc(sizeof(unsigned int)*(pattern->num_cols ? pattern->num_cols : 1));
+	memcpy(fill, col_start, sizeof(unsigned int)*pattern->num_cols);
+	for(i = 0; i < pattern->num_rows; i++){
+		for(p = pattern->row_start[i]; p < pattern->row_start[i + 1]; p++){
+			col_rows[fill[pattern->col_index[p]]++] = i;
+		}
+	}
+
+	//forbidden[c] == j + 1 marks color c as taken by a neighbor of column j
+	forbidden = calloc(pattern->num_cols ? pattern->num_cols : 1, sizeof(unsigned int));
+	for(j = 0; j < pattern->num_cols; j++){
+		if(col_start[j] == col_start[j + 1]){
+			colors[j] = 0;
+			continue;
+		}
+		for(q = col_start[j]; q < col_start[j + 1]; q++){
+			row = col_rows[q];
+			for(p = pattern->row_start[row]; p < pattern->row_start[row + 1]; p++){
+				if(pattern->col_index[p] < j){
+					forbidden[colors[pattern->col_index[p]]] = j + 1;
+				}
+			}
+		}
+		for(color = 0; forbidden[color] == j + 1; color++);
+		colors[j] = color;
+		if(color + 1 > num_colors){
+			num_colors = color + 1;
+		}
+	}
+
+	free(col_start);
+	free(col_rows);
+	free(fill);
+	free(forbidden);
+
+	return num_colors;
+}
+
+static void rad_multi_sparsity(rad_multi *multi){
+	rad_dependencies dep;
+	rad_index_set *rows;
+	unsigned int i;
+
+	rad_dependencies_init(&dep, multi->tape, multi->output_slots, multi->num_outputs);
+	rad_dependencies_sweep(&dep, NULL);
+	rows = calloc(multi->num_outputs ? multi->num_outputs : 1, sizeof(rad_index_set));
+	for(i = 0; i < multi->num_outputs; i++){
+		rad_dependencies_gather(&dep, multi->output_slots[i], rows + i, rad_dependencies_stamp(&dep), UINT_MAX);
+		rad_index_set_normalize(rows + i);
+	}
+	multi->jacobian_pattern = rad_csr_from_sets(rows, multi->num_outputs, multi->tape->num_inputs);
+	multi->colors = malloc(sizeof(unsigned int)*(multi->tape->num_inputs ? multi->tape->num_inputs : 1));
+	multi->num_colors = rad_color_columns(multi->jacobian_pattern, multi->colors);
+	rad_free_index_sets(rows, multi->num_outputs);
+	rad_dependencies_free(&dep);
+}
+
+static rad_csr *rad_csr_copy_pattern(rad_csr *pattern){
+	rad_csr *output;
+	unsigned int nnz;
+
+	nnz = pattern->row_start[pattern->num_rows];
+	output = malloc(sizeof(rad_csr));
+	output->num_rows = pattern->num_rows;
+	output->num_cols = pattern->num_cols;
+	output->row_start = malloc(sizeof(unsigned int)*(pattern->num_rows + 1));
+	memcpy(output->row_start, pattern->row_start, sizeof(unsigned int)*(pattern->num_rows + 1));
+	output->col_index = malloc(sizeof(unsigned int)*(nnz ? nnz : 1));
+	memcpy(output->col_index, pattern->col_index, sizeof(unsigned int)*nnz);
+	output->values = calloc(nnz ? nnz : 1, sizeof(double));
+
+	return output;
+}
+
+//Returns the Jacobian with one row per output and one column per input id. The structurally nonzero columns are
+//compressed by coloring, so a single vector forward pass with one direction per color computes every entry.
+rad_csr *rad_jacobian_sparse(rad_multi *multi, double *inputs){
+	rad_csr *output;
+	rad_ctx *ctx;
+	double *tangents;
+	double *out_derivs;
+	unsigned int num_colors;
+	unsigned int slot;
+	unsigned int i;
+	unsigned int p;
+
+	if(multi->jacobian_pattern == NULL){
+		rad_multi_sparsity(multi);
+	}
+	ctx = rad_tape_ctx(multi->tape);
+	num_colors = multi->num_colors ? multi->num_colors : 1;
+	output = rad_csr_copy_pattern(multi->jacobian_pattern);
+
+	tangents = calloc(multi->tape->num_inputs*num_colors + 1, sizeof(double));
+	out_derivs = malloc(sizeof(double)*num_colors);
+	for(i = 0; i < multi->tape->num_inputs; i++){
+		tangents[i*num_colors + multi->colors[i]] = 1;
+	}
+	rad_forward_grad_vec_ctx(ctx, inputs, tangents, num_colors, out_derivs);
+
+	for(i = 0; i < multi->num_outputs; i++){
+		slot = multi->output_slots[i];
+		multi->values[i] = ctx->values[slot];
+		for(p = output->row_start[i]; p < output->row_start[i + 1]; p++){
+			output->values[p] = ctx->tangents[slot*num_colors + multi->colors[output->col_index[p]]];
+		}
+	}
+
+	free(tangents);
+	free(out_derivs);
+
+	return output;
+}
+
+//Collects the pairs of inputs which interact through a nonlinear operation
+static rad_index_set *rad_hessian_pattern(rad_tape *tape){
+	rad_dependencies dep;
+	rad_index_set *rows;
+	unsigned int i;
+
+	rad_dependencies_init(&dep, tape, &tape->output, 1);
+	rows = calloc(tape->num_inputs ? tape->num_inputs : 1, sizeof(rad_index_set));
+	rad_dependencies_sweep(&dep, rows);
+	for(i = 0; i < tape->num_inputs; i++){
+		rad_index_set_normalize(rows + i);
+	}
+	rad_dependencies_free(&dep);
+
+	return rows;
+}
+
+//Returns the Hessian with one row and column per input id. Columns are colored so that no two columns of one
+//color share a row, and one Hessian-vector product per color computes every entry.
+rad_csr *rad_tape_hessian_sparse(rad_tape *tape, double *inputs){
+	rad_index_set *rows;
+	rad_csr *output;
+	unsigned int *colors;
+	double *v;
+	double *products;
+	unsigned int num_inputs;
+	unsigned int num_colors;
+	unsigned int color;
+	unsigned int i;
+	unsigned int p;
+
+	num_inputs = tape->num_inputs;
+	rows = rad_hessian_pattern(tape);
+	output = rad_csr_from_sets(rows, num_inputs, num_inputs);
+	rad_free_index_sets(rows, num_inputs);
+
+	colors = malloc(sizeof(unsigned int)*(num_inputs ? num_inputs : 1));
+	num_colors = rad_color_columns(output, colors);
+	v = malloc(sizeof(double)*(num_inputs ? num_inputs : 1));
+	products = calloc(num_colors*num_inputs + 1, sizeof(double));
+	for(color = 0; color < num_colors; color++){
+		for(i = 0; i < num_inputs; i++){
+			v[i] = colors[i] == color;
+		}
+		rad_hvp_ctx(rad_tape_ctx(tape), inputs, v, products + color*num_inputs);
+	}
+
+	for(i = 0; i < num_inputs; i++){
+		for(p = output->row_start[i]; p < output->row_start[i + 1]; p++){
+			output->values[p] = products[colors[output->col_index[p]]*num_inputs + i];
+		}
+	}
+
+	free(colors);
+	free(v);
+	free(products);
+
+	return output;
+}
+
+rad_csr *rad_hessian_sparse(rad_func *func, double *inputs){
+	rad_tape *tape;
+	rad_csr *output;
+
+	tape = rad_compile(func);
+	if(tape == NULL){
+		return NULL;
+	}
+	output = rad_tape_hessian_sparse(tape, inputs);
+	rad_tape_free(tape);
+
+	return output;
+}
@@ -0,0 +1,1120 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "rad.h"
+#include "rad_internal.h"
+
+//Batched evaluation processes the samples in blocks of this size so each column stays in cache
+#define RAD_BATCH_BLOCK 256
+
+//Each composition is compiled in its own scope, where INPUT nodes refer to the slots of the composition's arguments
+typedef struct rad_compile_scope rad_compile_scope;
+
+struct rad_compile_scope{
+	rad_node_map map;
+	bool is_composition;
+	unsigned int num_args;
+	unsigned int *arg_slots;
+};
+
+typedef struct rad_compile_frame rad_compile_frame;
+
+struct rad_compile_frame{
+	rad_func *func;
+	unsigned int next_child;
+	rad_compile_scope *scope;
+	rad_compile_scope *inner;
+};
+
+static rad_compile_scope *rad_create_scope(bool is_composition, unsigned int num_args){
+	rad_compile_scope *output;
+
+	output = malloc(sizeof(rad_compile_scope));
+	rad_node_map_init(&output->map);
+	output->is_composition = is_composition;
+	output->num_args = num_args;
+	if(num_args){
+		output->arg_slots = malloc(sizeof(unsigned int)*num_args);
+	} else {
+		output->arg_slots = NULL;
+	}
+
+	return output;
+}
+
+static void rad_free_scope(rad_compile_scope *scope){
+	rad_node_map_free(&scope->map);
+	free(scope->arg_slots);
+	free(scope);
+}
+
+static unsigned int rad_tape_push_op(rad_tape *tape, unsigned int *capacity, enum rad_oper operation){
+	if(tape->num_ops == *capacity){
+		*capacity *= 2;
+		tape->ops = realloc(tape->ops, sizeof(rad_tape_op)*(*capacity));
+	}
+	tape->ops[tape->num_ops].operation = operation;
+	tape->ops[tape->num_ops].operand0 = 0;
+	tape->ops[tape->num_ops].operand1 = 0;
+
+	return tape->num_ops++;
+}
+
+//Returns the slot of an input, which inside a composition is the slot of the composition's argument
+static bool rad_tape_input(rad_tape *tape, unsigned int *op_capacity, rad_compile_scope *scope, unsigned int input_id, unsigned int *slot){
+	if(scope->is_composition){
+		if(input_id >= scope->num_args){
+			return false;
+		}
+		*slot = scope->arg_slots[input_id];
+		return true;
+	}
+	*slot = rad_tape_push_op(tape, op_capacity, INPUT);
+	tape->ops[*slot].input_id = input_id;
+	if(input_id >= tape->num_inputs){
+		tape->num_inputs = input_id + 1;
+	}
+	return true;
+}
+
+static unsigned int rad_tape_binary(rad_tape *tape, unsigned int *op_capacity, enum rad_oper operation, unsigned int operand0, unsigned int operand1){
+	unsigned int output;
+
+	output = rad_tape_push_op(tape, op_capacity, operation);
+	tape->ops[output].operand0 = operand0;
+	tape->ops[output].operand1 = operand1;
+
+	return output;
+}
+
+//Expands a dense layer into the scalar instructions of each output, adding the terms in input order and then the bias
+//like rad_dense_eval. The last instructions are the outputs in order, so the layer's slot is the slot of its first
+//output and output i is in the slot after it by i.
+static bool rad_tape_emit_dense(rad_tape *tape, unsigned int *op_capacity, rad_compile_scope *scope, rad_func *func, unsigned int *slot){
+	unsigned int *sums;
+	unsigned int input_slot;
+	unsigned int weight_slot;
+	unsigned int weight;
+	unsigned int o;
+	unsigned int i;
+	bool success = true;
+
+	if(func->num_outputs == 0){
+		return false;
+	}
+	sums = malloc(sizeof(unsigned int)*2*func->num_outputs);
+	weight = func->weight_base;
+	for(o = 0; o < func->num_outputs && success; o++){
+		if(func->num_inputs == 0){
+			sums[o] = rad_tape_push_op(tape, op_capacity, CONSTANT);
+			tape->ops[sums[o]].const_value = 0;
+		}
+		for(i = 0; i < func->num_inputs && success; i++){
+			rad_node_map_get(&scope->map, func->inputs[i], &input_slot);
+			success = rad_tape_input(tape, op_capacity, scope, weight++, &weight_slot);
+			if(success){
+				input_slot = rad_tape_binary(tape, op_capacity, MULTIPLY, input_slot, weight_slot);
+				sums[o] = i ? rad_tape_binary(tape, op_capacity, ADD, sums[o], input_slot) : input_slot;
+			}
+		}
+		success = success && rad_tape_input(tape, op_capacity, scope, weight++, sums + func->num_outputs + o);
+	}
+	if(success){
+		*slot = tape->num_ops;
+		for(o = 0; o < func->num_outputs; o++){
+			rad_tape_binary(tape, op_capacity, ADD, sums[o], sums[func->num_outputs + o]);
+		}
+	}
+	free(sums);
+
+	return success;
+}
+
+//Emits the instruction for a node whose children have all been compiled and returns its slot
+static bool rad_tape_emit(rad_tape *tape, unsigned int *op_capacity, unsigned int *arg_capacity, rad_compile_frame *frame, unsigned int *slot){
+	rad_func *func;
+	rad_compile_scope *scope;
+	rad_tape_op *op;
+	unsigned int i;
+
+	func = frame->func;
+	scope = frame->scope;
+	switch(func->operation){
+		case CONSTANT:
+			*slot = rad_tape_push_op(tape, op_capacity, CONSTANT);
+			tape->ops[*slot].const_value = func->const_value;
+			return true;
+		case INPUT:
+			return rad_tape_input(tape, op_capacity, scope, func->input_id, slot);
+		case ADD:
+		case SUBTRACT:
+		case MULTIPLY:
+		case DIVIDE:
+		case POW:
+			*slot = rad_tape_push_op(tape, op_capacity, func->operation);
+			op = tape->ops + *slot;
+			rad_node_map_get(&scope->map, func->operand0, &op->operand0);
+			rad_node_map_get(&scope->map, func->operand1, &op->operand1);
+			return true;
+		case EXP:
+		case LOG:
+		case SIN:
+		case COS:
+		case TANH:
+		case SQRT:
+		case SIGMOID:
+			*slot = rad_tape_push_op(tape, op_capacity, func->operation);
+			rad_node_map_get(&scope->map, func->operand0, &tape->ops[*slot].operand0);
+			return true;
+		case CUSTOM:
+			*slot = rad_tape_push_op(tape, op_capacity, CUSTOM);
+			op = tape->ops + *slot;
+			op->num_inputs = func->num_inputs;
+			op->first_input = tape->num_args;
+			op->custom_eval = func->custom_eval;
+			while(tape->num_args + func->num_inputs > *arg_capacity){
+				*arg_capacity *= 2;
+				tape->args = realloc(tape->args, sizeof(unsigned int)*(*arg_capacity));
+			}
+			for(i = 0; i < func->num_inputs; i++){
+				rad_node_map_get(&scope->map, func->inputs[i], tape->args + tape->num_args + i);
+			}
+			tape->num_args += func->num_inputs;
+			if(func->num_inputs > tape->max_custom_inputs){
+				tape->max_custom_inputs = func->num_inputs;
+			}
+			return true;
+		case DENSE:
+			return rad_tape_emit_dense(tape, op_capacity, scope, func, slot);
+		case DENSE_OUTPUT:
+			rad_node_map_get(&scope->map, func->layer, slot);
+			*slot += func->output_index;
+			return func->output_index < func->layer->num_outputs;
+		case COMPOSITION:
+			return rad_node_map_get(&frame->inner->map, func->func, slot);
+		default:
+			return false;
+	}
+}
+
+//Returns the number of operands of an instruction and points operands at their slots. pair is used as storage for
+//instructions with at most two operands.
+unsigned int rad_tape_operands(rad_tape *tape, rad_tape_op *op, unsigned int **operands, unsigned int *pair){
+	pair[0] = op->operand0;
+	pair[1] = op->operand1;
+	*operands = pair;
+	switch(op->operation){
+		case ADD:
+		case SUBTRACT:
+		case MULTIPLY:
+		case DIVIDE:
+		case POW:
+			return 2;
+		case EXP:
+		case LOG:
+		case SIN:
+		case COS:
+		case TANH:
+		case SQRT:
+		case SIGMOID:
+			return 1;
+		case CUSTOM:
+			*operands = tape->args + op->first_input;
+			return op->num_inputs;
+		default:
+			return 0;
+	}
+}
+
+//Builds the reverse edges of the tape: the instructions which read each slot, and the INPUT instructions of each input id
+static void rad_tape_index_users(rad_tape *tape){
+	unsigned int *operands;
+	unsigned int *fill;
+	unsigned int pair[2];
+	unsigned int num_operands;
+	unsigned int i;
+	unsigned int j;
+
+	tape->user_start = calloc(tape->num_ops + 1, sizeof(unsigned int));
+	tape->input_start = calloc(tape->num_inputs + 1, sizeof(unsigned int));
+	for(i = 0; i < tape->num_ops; i++){
+		num_operands = rad_tape_operands(tape, tape->ops + i, &operands, pair);
+		for(j = 0; j < num_operands; j++){
+			tape->user_start[operands[j] + 1]++;
+		}
+		if(tape->ops[i].operation == INPUT){
+			tape->input_start[tape->ops[i].input_id + 1]++;
+		}
+	}
+	for(i = 0; i < tape->num_ops; i++){
+		tape->user_start[i + 1] += tape->user_start[i];
+	}
+	for(i = 0; i < tape->num_inputs; i++){
+		tape->input_start[i + 1] += tape->input_start[i];
+	}
+
+	tape->users = malloc(sizeof(unsigned int)*(tape->user_start[tape->num_ops] + 1));
+	tape->input_slots = malloc(sizeof(unsigned int)*(tape->input_start[tape->num_inputs] + 1));
+	fill = malloc(sizeof(unsigned int)*(tape->num_ops + 1));
+	memcpy(fill, tape->user_start, sizeof(unsigned int)*tape->num_ops);
+	for(i = 0; i < tape->num_ops; i++){
+		num_operands = rad_tape_operands(tape, tape->ops + i, &operands, pair);
+		for(j = 0; j < num_operands; j++){
+			tape->users[fill[operands[j]]++] = i;
+		}
+	}
+	memcpy(fill, tape->input_start, sizeof(unsigned int)*tape->num_inputs);
+	for(i = 0; i < tape->num_ops; i++){
+		if(tape->ops[i].operation == INPUT){
+			tape->input_slots[fill[tape->ops[i].input_id]++] = i;
+		}
+	}
+	free(fill);
+}
+
+//Compiles several functions into one tape, sharing their common subexpressions. The slot of funcs[i] is stored in output_slots[i].
+rad_tape *rad_compile_roots(/*not consumed*/rad_func **funcs, unsigned int num_funcs, unsigned int *output_slots){
+	rad_tape *output;
+	rad_compile_frame *stack;
+	rad_compile_frame *frame;
+	rad_compile_scope *scope;
+	rad_func *child;
+	unsigned int stack_size = 0;
+	unsigned int stack_capacity = 16;
+	unsigned int op_capacity = 16;
+	unsigned int arg_capacity = 16;
+	unsigned int slot;
+	unsigned int root;
+	unsigned int i;
+	bool success = true;
+
+	output = malloc(sizeof(rad_tape));
+	output->num_ops = 0;
+	output->ops = malloc(sizeof(rad_tape_op)*op_capacity);
+	output->output = 0;
+	output->num_args = 0;
+	output->args = malloc(sizeof(unsigned int)*arg_capacity);
+	output->num_inputs = 0;
+	output->max_custom_inputs = 0;
+
+	scope = rad_create_scope(false, 0);
+	stack = malloc(sizeof(rad_compile_frame)*stack_capacity);
+
+	for(root = 0; root < num_funcs && success; root++){
+		if(rad_node_map_get(&scope->map, funcs[root], NULL)){
+			continue;
+		}
+		stack[0] = (rad_compile_frame) {.func = funcs[root], .next_child = 0, .scope = scope, .inner = NULL};
+		stack_size = 1;
+
+		while(stack_size){
+			frame = stack + stack_size - 1;
+			if(frame->next_child < rad_num_children(frame->func)){
+				child = rad_child(frame->func, frame->next_child);
+				frame->next_child++;
+				if(!rad_node_map_get(&frame->scope->map, child, NULL)){
+					if(stack_size == stack_capacity){
+						stack_capacity *= 2;
+						stack = realloc(stack, sizeof(rad_compile_frame)*stack_capacity);
+						frame = stack + stack_size - 1;
+					}
+					stack[stack_size] = (rad_compile_frame) {.func = child, .next_child = 0, .scope = frame->scope, .inner = NULL};
+					stack_size++;
+				}
+				continue;
+			}
+
+			if(frame->func->operation == COMPOSITION && frame->inner == NULL){
+				frame->inner = rad_create_scope(true, frame->func->num_inputs);
+				for(i = 0; i < frame->func->num_inputs; i++){
+					rad_node_map_get(&frame->scope->map, frame->func->inputs[i], frame->inner->arg_slots + i);
+				}
+				if(stack_size == stack_capacity){
+					stack_capacity *= 2;
+					stack = realloc(stack, sizeof(rad_compile_frame)*stack_capacity);
+					frame = stack + stack_size - 1;
+				}
+				stack[stack_size] = (rad_compile_frame) {.func = frame->func->func, .next_child = 0, .scope = frame->inner, .inner = NULL};
+				stack_size++;
+				continue;
+			}
+
+			if(!rad_tape_emit(output, &op_capacity, &arg_capacity, frame, &slot)){
+				success = false;
+				break;
+			}
+			rad_node_map_set(&frame->scope->map, frame->func, slot);
+			if(frame->inner != NULL){
+				rad_free_scope(frame->inner);
+			}
+			stack_size--;
+		}
+	}
+
+	if(success){
+		for(root = 0; root < num_funcs; root++){
+			rad_node_map_get(&scope->map, funcs[root], output_slots + root);
+		}
+	}
+
+	while(stack_size){
+		stack_size--;
+		if(stack[stack_size].inner != NULL){
+			rad_free_scope(stack[stack_size].inner);
+		}
+	}
+	free(stack);
+	rad_free_scope(scope);
+
+	if(!success){
+		free(output->ops);
+		free(output->args);
+		free(output);
+		return NULL;
+	}
+
+	if(num_funcs){
+		output->output = output_slots[0];
+	}
+	rad_tape_index_users(output);
+	output->ctx = NULL;
+
+	return output;
+}
+
+//Returns NULL if func contains an ARG node, or an INPUT node inside a composition whose id is not one of its arguments
+rad_tape *rad_compile(/*not consumed*/rad_func *func){
+	unsigned int output_slot;
+
+	return rad_compile_roots(&func, 1, &output_slot);
+}
+
+void rad_tape_free(rad_tape *tape){
+	if(tape->ctx != NULL){
+		rad_ctx_free(tape->ctx);
+	}
+	free(tape->ops);
+	free(tape->args);
+	free(tape->user_start);
+	free(tape->users);
+	free(tape->input_start);
+	free(tape->input_slots);
+	free(tape);
+}
+
+rad_ctx *rad_ctx_create(/*not consumed*/rad_tape *tape){
+	rad_ctx *output;
+
+	output = malloc(sizeof(rad_ctx));
+	output->tape = tape;
+	output->values = malloc(sizeof(double)*tape->num_ops);
+	output->adjoints = malloc(sizeof(double)*tape->num_ops);
+	output->partials = malloc(sizeof(double)*tape->num_args);
+	output->scratch = malloc(sizeof(double)*2*tape->max_custom_inputs);
+	output->tangent_width = 0;
+	output->tangents = NULL;
+	output->adjoint_tangents = NULL;
+	output->partial_tangents = NULL;
+	output->valid = false;
+	output->dirty = NULL;
+	output->heap = NULL;
+	output->batch_capacity = 0;
+	output->batch_values = NULL;
+	output->batch_adjoints = NULL;
+	output->batch_partials = NULL;
+	output->batch_columns = malloc(sizeof(double *)*2*(tape->max_custom_inputs + 1));
+
+	return output;
+}
+
+//The context of the functions which take a tape but no context, created on their first call
+rad_ctx *rad_tape_ctx(rad_tape *tape){
+	if(tape->ctx == NULL){
+		tape->ctx = rad_ctx_create(tape);
+	}
+
+	return tape->ctx;
+}
+
+void rad_ctx_free(rad_ctx *ctx){
+	free(ctx->values);
+	free(ctx->adjoints);
+	free(ctx->partials);
+	free(ctx->scratch);
+	free(ctx->tangents);
+	free(ctx->adjoint_tangents);
+	free(ctx->partial_tangents);
+	free(ctx->dirty);
+	free(ctx->heap);
+	free(ctx->batch_values);
+	free(ctx->batch_adjoints);
+	free(ctx->batch_partials);
+	free(ctx->batch_columns);
+	free(ctx);
+}
+
+static inline void rad_ctx_eval_op(rad_ctx *ctx, double *inputs, unsigned int i){
+	rad_tape *tape;
+	rad_tape_op *op;
+	double *values;
+	unsigned int j;
+
+	tape = ctx->tape;
+	values = ctx->values;
+	op = tape->ops + i;
+	switch(op->operation){
+		case CONSTANT:
+			values[i] = op->const_value;
+			break;
+		case INPUT:
+			values[i] = inputs[op->input_id];
+			break;
+		case ADD:
+			values[i] = values[op->operand0] + values[op->operand1];
+			break;
+		case SUBTRACT:
+			values[i] = values[op->operand0] - values[op->operand1];
+			break;
+		case MULTIPLY:
+			values[i] = values[op->operand0]*values[op->operand1];
+			break;
+		case DIVIDE:
+			values[i] = values[op->operand0]/values[op->operand1];
+			break;
+		case POW:
+			values[i] = pow(values[op->operand0], values[op->operand1]);
+			break;
+		case EXP:
+		case LOG:
+		case SIN:
+		case COS:
+		case TANH:
+		case SQRT:
+		case SIGMOID:
+			values[i] = rad_unary_eval(op->operation, values[op->operand0]);
+			break;
+		case CUSTOM:
+			for(j = 0; j < op->num_inputs; j++){
+				ctx->scratch[j] = values[tape->args[op->first_input + j]];
+			}
+			values[i] = op->custom_eval(ctx->scratch, ctx->partials + op->first_input);
+			break;
+		default:
+			break;
+	}
+}
+
+void rad_ctx_forward(rad_ctx *ctx, double *inputs){
+	unsigned int i;
+
+	for(i = 0; i < ctx->tape->num_ops; i++){
+		rad_ctx_eval_op(ctx, inputs, i);
+	}
+	ctx->valid = true;
+}
+
+double rad_eval_ctx(rad_ctx *ctx, double *inputs){
+	rad_ctx_forward(ctx, inputs);
+	return ctx->values[ctx->tape->output];
+}
+
+//Propagates the adjoints already seeded in ctx->adjoints for the first num_ops slots back to the inputs, adding the
+//result to derivatives. ctx->values must hold the values of the last forward pass.
+void rad_ctx_reverse(rad_ctx *ctx, unsigned int num_ops, double *derivatives){
+	rad_tape *tape;
+	rad_tape_op *op;
+	double *values;
+	double *adjoints;
+	double deriv;
+	unsigned int i;
+	unsigned int j;
+
+	tape = ctx->tape;
+	values = ctx->values;
+	adjoints = ctx->adjoints;
+	for(i = num_ops; i-- > 0;){
+		op = tape->ops + i;
+		deriv = adjoints[i];
+		switch(op->operation){
+			case INPUT:
+				derivatives[op->input_id] += deriv;
+				break;
+			case ADD:
+				adjoints[op->operand0] += deriv;
+				adjoints[op->operand1] += deriv;
+				break;
+			case SUBTRACT:
+				adjoints[op->operand0] += deriv;
+				adjoints[op->operand1] -= deriv;
+				break;
+			case MULTIPLY:
+				adjoints[op->operand0] += deriv*values[op->operand1];
+				adjoints[op->operand1] += deriv*values[op->operand0];
+				break;
+			case DIVIDE:
+				adjoints[op->operand0] += deriv/values[op->operand1];
+				adjoints[op->operand1] += -deriv*values[op->operand0]/(values[op->operand1]*values[op->operand1]);
+				break;
+			case POW:
+				adjoints[op->operand0] += deriv*rad_pow_deriv0(values[op->operand0], values[op->operand1]);
+				adjoints[op->operand1] += deriv*rad_pow_deriv1(values[op->operand0], values[i]);
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				adjoints[op->operand0] += deriv*rad_unary_deriv(op->operation, values[op->operand0], values[i]);
+				break;
+			case CUSTOM:
+				for(j = 0; j < op->num_inputs; j++){
+					adjoints[tape->args[op->first_input + j]] += deriv*ctx->partials[op->first_input + j];
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+double rad_backward_diff_ctx(rad_ctx *ctx, double *inputs, double *derivatives){
+	rad_tape *tape;
+
+	tape = ctx->tape;
+	rad_ctx_forward(ctx, inputs);
+	memset(ctx->adjoints, 0, sizeof(double)*(tape->output + 1));
+	ctx->adjoints[tape->output] = 1;
+	rad_ctx_reverse(ctx, tape->output + 1, derivatives);
+
+	return ctx->values[tape->output];
+}
+
+static void rad_heap_push(unsigned int *heap, unsigned int *size, unsigned int slot){
+	unsigned int i;
+
+	i = (*size)++;
+	while(i && heap[(i - 1)/2] > slot){
+		heap[i] = heap[(i - 1)/2];
+		i = (i - 1)/2;
+	}
+	heap[i] = slot;
+}
+
+static unsigned int rad_heap_pop(unsigned int *heap, unsigned int *size){
+	unsigned int output;
+	unsigned int last;
+	unsigned int child;
+	unsigned int i = 0;
+
+	output = heap[0];
+	last = heap[--*size];
+	while(2*i + 1 < *size){
+		child = 2*i + 1;
+		if(child + 1 < *size && heap[child + 1] < heap[child]){
+			child++;
+		}
+		if(heap[child] >= last){
+			break;
+		}
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+
+	return output;
+}
+
+//Re-evaluates the tape after the inputs listed in changed were modified, recomputing only the instructions downstream
+//of them in topological order. Propagation stops at instructions whose value did not change. The values of the other
+//inputs are taken from the previous evaluation with this context, so inputs only needs to hold the changed entries.
+//If the context has not evaluated the tape yet, the whole tape is evaluated.
+double rad_eval_incremental_ctx(rad_ctx *ctx, double *inputs, unsigned int *changed, unsigned int num_changed){
+	rad_tape *tape;
+	double old_value;
+	unsigned int heap_size = 0;
+	unsigned int slot;
+	unsigned int i;
+	unsigned int p;
+
+	tape = ctx->tape;
+	if(!ctx->valid){
+		rad_ctx_forward(ctx, inputs);
+		return ctx->values[tape->output];
+	}
+	if(ctx->dirty == NULL){
+		ctx->dirty = calloc(tape->num_ops + 1, sizeof(bool));
+		ctx->heap = malloc(sizeof(unsigned int)*(tape->num_ops + 1));
+	}
+
+	for(i = 0; i < num_changed; i++){
+		if(changed[i] >= tape->num_inputs){
+			continue;
+		}
+		for(p = tape->input_start[changed[i]]; p < tape->input_start[changed[i] + 1]; p++){
+			slot = tape->input_slots[p];
+			if(!ctx->dirty[slot]){
+				ctx->dirty[slot] = true;
+				rad_heap_push(ctx->heap, &heap_size, slot);
+			}
+		}
+	}
+
+	while(heap_size){
+		slot = rad_heap_pop(ctx->heap, &heap_size);
+		ctx->dirty[slot] = false;
+		old_value = ctx->values[slot];
+		rad_ctx_eval_op(ctx, inputs, slot);
+		//Compared bitwise, since a change between 0 and -0 still changes the result of 1/x
+		if(!memcmp(ctx->values + slot, &old_value, sizeof(double))){
+			continue;
+		}
+		for(p = tape->user_start[slot]; p < tape->user_start[slot + 1]; p++){
+			if(!ctx->dirty[tape->users[p]]){
+				ctx->dirty[tape->users[p]] = true;
+				rad_heap_push(ctx->heap, &heap_size, tape->users[p]);
+			}
+		}
+	}
+
+	return ctx->values[tape->output];
+}
+
+//Like rad_eval_incremental_ctx, followed by a reverse pass over the cached values
+double rad_backward_diff_incremental_ctx(rad_ctx *ctx, double *inputs, unsigned int *changed, unsigned int num_changed, double *derivatives){
+	rad_tape *tape;
+
+	tape = ctx->tape;
+	rad_eval_incremental_ctx(ctx, inputs, changed, num_changed);
+	memset(ctx->adjoints, 0, sizeof(double)*(tape->output + 1));
+	ctx->adjoints[tape->output] = 1;
+	rad_ctx_reverse(ctx, tape->output + 1, derivatives);
+
+	return ctx->values[tape->output];
+}
+
+//Propagates num_directions tangent vectors at once. The tangent of input i in direction k is tangents[i*num_directions + k],
+//and the directional derivative of the output along direction k is stored in out_derivs[k].
+double rad_forward_grad_vec_ctx(rad_ctx *ctx, double *inputs, double *tangents, unsigned int num_directions, double *out_derivs){
+	rad_tape *tape;
+	rad_tape_op *op;
+	double *values;
+	double *out;
+	double *t0;
+	double *t1;
+	double *partials;
+	double deriv0;
+	double deriv1;
+	unsigned int i;
+	unsigned int j;
+	unsigned int k;
+
+	tape = ctx->tape;
+	rad_ctx_forward(ctx, inputs);
+	if(num_directions > ctx->tangent_width){
+		free(ctx->tangents);
+		ctx->tangent_width = num_directions;
+		ctx->tangents = malloc(sizeof(double)*tape->num_ops*num_directions);
+	}
+
+	values = ctx->values;
+	for(i = 0; i < tape->num_ops; i++){
+		op = tape->ops + i;
+		out = ctx->tangents + i*num_directions;
+		t0 = ctx->tangents + op->operand0*num_directions;
+		t1 = ctx->tangents + op->operand1*num_directions;
+		switch(op->operation){
+			case CONSTANT:
+				memset(out, 0, sizeof(double)*num_directions);
+				break;
+			case INPUT:
+				memcpy(out, tangents + op->input_id*num_directions, sizeof(double)*num_directions);
+				break;
+			case ADD:
+				for(k = 0; k < num_directions; k++){
+					out[k] = t0[k] + t1[k];
+				}
+				break;
+			case SUBTRACT:
+				for(k = 0; k < num_directions; k++){
+					out[k] = t0[k] - t1[k];
+				}
+				break;
+			case MULTIPLY:
+				deriv0 = values[op->operand1];
+				deriv1 = values[op->operand0];
+				for(k = 0; k < num_directions; k++){
+					out[k] = deriv1*t1[k] + deriv0*t0[k];
+				}
+				break;
+			case DIVIDE:
+				deriv0 = values[op->operand1];
+				deriv1 = values[op->operand0];
+				for(k = 0; k < num_directions; k++){
+					out[k] = (t0[k]*deriv0 - t1[k]*deriv1)/(deriv0*deriv0);
+				}
+				break;
+			case POW:
+				deriv0 = rad_pow_deriv0(values[op->operand0], values[op->operand1]);
+				deriv1 = rad_pow_deriv1(values[op->operand0], values[i]);
+				for(k = 0; k < num_directions; k++){
+					out[k] = t0[k]*deriv0;
+					if(t1[k] != 0){
+						out[k] += t1[k]*deriv1;
+					}
+				}
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				deriv0 = rad_unary_deriv(op->operation, values[op->operand0], values[i]);
+				for(k = 0; k < num_directions; k++){
+					out[k] = t0[k]*deriv0;
+				}
+				break;
+			case CUSTOM:
+				memset(out, 0, sizeof(double)*num_directions);
+				partials = ctx->partials + op->first_input;
+				for(j = 0; j < op->num_inputs; j++){
+					t0 = ctx->tangents + tape->args[op->first_input + j]*num_directions;
+					for(k = 0; k < num_directions; k++){
+						out[k] += t0[k]*partials[j];
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	memcpy(out_derivs, ctx->tangents + tape->output*num_directions, sizeof(double)*num_directions);
+
+	return values[tape->output];
+}
+
+double rad_tape_eval(rad_tape *tape, double *inputs){
+	return rad_eval_ctx(rad_tape_ctx(tape), inputs);
+}
+
+double rad_tape_backward(rad_tape *tape, double *inputs, double *derivatives){
+	return rad_backward_diff_ctx(rad_tape_ctx(tape), inputs, derivatives);
+}
+
+static void rad_ctx_reserve_batch(rad_ctx *ctx, unsigned int batch_size){
+	rad_tape *tape;
+
+	if(batch_size <= ctx->batch_capacity){
+		return;
+	}
+	tape = ctx->tape;
+	free(ctx->batch_values);
+	free(ctx->batch_adjoints);
+	free(ctx->batch_partials);
+	ctx->batch_capacity = batch_size;
+	ctx->batch_values = malloc(sizeof(double)*tape->num_ops*batch_size);
+	ctx->batch_adjoints = malloc(sizeof(double)*tape->num_ops*batch_size);
+	ctx->batch_partials = malloc(sizeof(double)*tape->num_args*batch_size);
+}
+
+//Evaluates n samples, storing the values of slot i in the column values[i*n .. i*n + n - 1]. Custom functions with
+//batch kernels also store their partial derivatives if partials is set and they have no batch_vjp.
+static void rad_ctx_forward_batch(rad_ctx *ctx, double *inputs, unsigned int n, unsigned int stride, bool partials){
+	const rad_kernels *kernels;
+	const rad_custom_entry *entry;
+	rad_tape *tape;
+	rad_tape_op *op;
+	double **columns;
+	double *values;
+	double *out;
+	double *in0;
+	double *in1;
+	unsigned int i;
+	unsigned int j;
+	unsigned int k;
+
+	kernels = rad_get_kernels();
+	tape = ctx->tape;
+	values = ctx->batch_values;
+	for(i = 0; i < tape->num_ops; i++){
+		op = tape->ops + i;
+		out = values + i*n;
+		in0 = values + op->operand0*n;
+		in1 = values + op->operand1*n;
+		switch(op->operation){
+			case CONSTANT:
+				for(k = 0; k < n; k++){
+					out[k] = op->const_value;
+				}
+				break;
+			case INPUT:
+				for(k = 0; k < n; k++){
+					out[k] = inputs[k*stride + op->input_id];
+				}
+				break;
+			case ADD:
+				kernels->add(out, in0, in1, n);
+				break;
+			case SUBTRACT:
+				kernels->subtract(out, in0, in1, n);
+				break;
+			case MULTIPLY:
+				kernels->multiply(out, in0, in1, n);
+				break;
+			case DIVIDE:
+				kernels->divide(out, in0, in1, n);
+				break;
+			case POW:
+				for(k = 0; k < n; k++){
+					out[k] = pow(in0[k], in1[k]);
+				}
+				break;
+			case EXP:
+			case LOG:
+			case SIN:
+			case COS:
+			case TANH:
+			case SQRT:
+			case SIGMOID:
+				for(k = 0; k < n; k++){
+					out[k] = rad_unary_eval(op->operation, in0[k]);
+				}
+				break;
+			case CUSTOM:
+				entry = rad_custom_lookup(op->custom_eval);
+				if(entry != NULL && entry->batch_eval != NULL){
+					columns = ctx->batch_columns;
+					for(j = 0; j < op->num_inputs; j++){
+						columns[j] = values + tape->args[op->first_input + j]*n;
+						columns[op->num_inputs + j] = ctx->batch_partials + (op->first_input + j)*n;
+					}
+					entry->batch_eval(columns, out, partials && entry->batch_vjp == NULL ? columns + op->num_inputs : NULL, n);
+					break;
+				}
+				for(k = 0; k < n; k++){
+					for(j = 0; j < op->num_inputs; j++){
+						ctx->scratch[j] = values[tape->args[op->first_input + j]*n + k];
+					}
+					out[k] = op->custom_eval(ctx->scratch, ctx->scratch + op->num_inputs);
+					for(j = 0; j < op->num_inputs; j++){
+						ctx->batch_partials[(op->first_input + j)*n + k] = ctx->scratch[op->num_inputs + j];
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+void rad_eval_batch_ctx(rad_ctx *ctx, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs){
+	unsigned int start;
+	unsigned int n;
+
+	for(start = 0; start < batch_size; start += n){
+		n = batch_size - start;
+		if(n > RAD_BATCH_BLOCK){
+			n = RAD_BATCH_BLOCK;
+		}
+		rad_ctx_reserve_batch(ctx, n);
+		rad_ctx_forward_batch(ctx, inputs + start*stride, n, stride, false);
+		memcpy(outputs + start, ctx->batch_values + ctx->tape->output*n, sizeof(double)*n);
+	}
+}
+
+//If deriv_stride is zero, the gradients of all samples are summed into derivatives.
+//Otherwise the gradient of sample k is added to derivatives + k*deriv_stride.
+void rad_backward_diff_batch_ctx(rad_ctx *ctx, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs, double *derivatives, unsigned int deriv_stride){
+	const rad_kernels *kernels;
+	const rad_custom_entry *entry;
+	rad_tape *tape;
+	rad_tape_op *op;
+	double **columns;
+	double *values;
+	double *adjoints;
+	double *adj;
+	double *adj0;
+	double *adj1;
+	double *in0;
+	double *in1;
+	double *partials;
+	double *deriv;
+	double sum;
+	unsigned int start;
+	unsigned int n;
+	unsigned int i;
+	unsigned int j;
+	unsigned int k;
+
+	kernels = rad_get_kernels();
+	tape = ctx->tape;
+	for(start = 0; start < batch_size; start += n){
+		n = batch_size - start;
+		if(n > RAD_BATCH_BLOCK){
+			n = RAD_BATCH_BLOCK;
+		}
+		rad_ctx_reserve_batch(ctx, n);
+		rad_ctx_forward_batch(ctx, inputs + start*stride, n, stride, true);
+		if(outputs != NULL){
+			memcpy(outputs + start, ctx->batch_values + ctx->tape->output*n, sizeof(double)*n);
+		}
+
+		values = ctx->batch_values;
+		adjoints = ctx->batch_adjoints;
+		memset(adjoints, 0, sizeof(double)*tape->num_ops*n);
+		for(k = 0; k < n; k++){
+			adjoints[tape->output*n + k] = 1;
+		}
+
+		for(i = tape->num_ops; i-- > 0;){
+			op = tape->ops + i;
+			adj = adjoints + i*n;
+			adj0 = adjoints + op->operand0*n;
+			adj1 = adjoints + op->operand1*n;
+			in0 = values + op->operand0*n;
+			in1 = values + op->operand1*n;
+			switch(op->operation){
+				case INPUT:
+					if(deriv_stride == 0){
+						sum = 0;
+						for(k = 0; k < n; k++){
+							sum += adj[k];
+						}
+						derivatives[op->input_id] += sum;
+					} else {
+						deriv = derivatives + start*deriv_stride + op->input_id;
+						for(k = 0; k < n; k++){
+							deriv[k*deriv_stride] += adj[k];
+						}
+					}
+					break;
+				case ADD:
+					kernels->add_adjoint(adj0, adj1, adj, in0, in1, n);
+					break;
+				case SUBTRACT:
+					kernels->subtract_adjoint(adj0, adj1, adj, in0, in1, n);
+					break;
+				case MULTIPLY:
+					kernels->multiply_adjoint(adj0, adj1, adj, in0, in1, n);
+					break;
+				case DIVIDE:
+					kernels->divide_adjoint(adj0, adj1, adj, in0, in1, n);
+					break;
+				case POW:
+					for(k = 0; k < n; k++){
+						adj0[k] += adj[k]*rad_pow_deriv0(in0[k], in1[k]);
+						adj1[k] += adj[k]*rad_pow_deriv1(in0[k], values[i*n + k]);
+					}
+					break;
+				case EXP:
+					kernels->exp_adjoint(adj0, adj, in0, values + i*n, n);
+					break;
+				case LOG:
+					kernels->log_adjoint(adj0, adj, in0, values + i*n, n);
+					break;
+				case TANH:
+					kernels->tanh_adjoint(adj0, adj, in0, values + i*n, n);
+					break;
+				case SQRT:
+					kernels->sqrt_adjoint(adj0, adj, in0, values + i*n, n);
+					break;
+				case SIGMOID:
+					kernels->sigmoid_adjoint(adj0, adj, in0, values + i*n, n);
+					break;
+				case SIN:
+				case COS:
+					for(k = 0; k < n; k++){
+						adj0[k] += adj[k]*rad_unary_deriv(op->operation, in0[k], values[i*n + k]);
+					}
+					break;
+				case CUSTOM:
+					entry = rad_custom_lookup(op->custom_eval);
+					if(entry != NULL && entry->batch_vjp != NULL){
+						columns = ctx->batch_columns;
+						for(j = 0; j < op->num_inputs; j++){
+							columns[j] = values + tape->args[op->first_input + j]*n;
+							columns[op->num_inputs + j] = adjoints + tape->args[op->first_input + j]*n;
+						}
+						entry->batch_vjp(columns, values + i*n, adj, columns + op->num_inputs, n);
+						break;
+					}
+					for(j = 0; j < op->num_inputs; j++){
+						adj0 = adjoints + tape->args[op->first_input + j]*n;
+						partials = ctx->batch_partials + (op->first_input + j)*n;
+						for(k = 0; k < n; k++){
+							adj0[k] += adj[k]*partials[k];
+						}
+					}
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
+void rad_tape_eval_batch(rad_tape *tape, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs){
+	rad_eval_batch_ctx(rad_tape_ctx(tape), inputs, batch_size, stride, outputs);
+}
+
+void rad_tape_backward_batch(rad_tape *tape, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs, double *derivatives, unsigned int deriv_stride){
+	rad_backward_diff_batch_ctx(rad_tape_ctx(tape), inputs, batch_size, stride, outputs, derivatives, deriv_stride);
+}
+
+double rad_tape_eval_incremental(rad_tape *tape, double *inputs, unsigned int *changed, unsigned int num_changed){
+	return rad_eval_incremental_ctx(rad_tape_ctx(tape), inputs, changed, num_changed);
+}
+
+double rad_tape_backward_incremental(rad_tape *tape, double *inputs, unsigned int *changed, unsigned int num_changed, double *derivatives){
+	return rad_backward_diff_incremental_ctx(rad_tape_ctx(tape), inputs, changed, num_changed, derivatives);
+}
+
+double rad_tape_forward_grad_vec(rad_tape *tape, double *inputs, double *tangents, unsigned int num_directions, double *out_derivs){
+	return rad_forward_grad_vec_ctx(rad_tape_ctx(tape), inputs, tangents, num_directions, out_derivs);
+}
+
+double rad_forward_grad_vec(rad_func *func, double *inputs, double *tangents, unsigned int num_directions, double *out_derivs){
+	rad_tape *tape;
+	double output;
+
+	tape = rad_compile(func);
+	if(tape == NULL){
+		return NAN;
+	}
+	output = rad_tape_forward_grad_vec(tape, inputs, tangents, num_directions, out_derivs);
+	rad_tape_free(tape);
+
+	return output;
+}
+
+//The functions which compile a RAD function for a single call return false, NULL or NAN if it cannot be compiled
+bool rad_eval_batch(rad_func *func, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs){
+	rad_tape *tape;
+
+	tape = rad_compile(func);
+	if(tape == NULL){
+		return false;
+	}
+	rad_tape_eval_batch(tape, inputs, batch_size, stride, outputs);
+	rad_tape_free(tape);
+
+	return true;
+}
+
+bool rad_backward_diff_batch(rad_func *func, double *inputs, unsigned int batch_size, unsigned int stride, double *outputs, double *derivatives, unsigned int deriv_stride){
+	rad_tape *tape;
+
+	tape = rad_compile(func);
+	if(tape == NULL){
+		return false;
+	}
+	rad_tape_backward_batch(tape, inputs, batch_size, stride, outputs, derivatives, deriv_stride);
+	rad_tape_free(tape);
+
+	return true;
+}
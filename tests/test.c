@@ -0,0 +1,666 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "../rad.h"
+
+//Checks every evaluator against rad_backward_diff, and rad_backward_diff against finite differences of rad_eval, on
+//graphs with shared nodes, compositions, custom functions and dense layers. Prints each failed check and exits with
+//a nonzero status if there was one.
+
+#define TEST_SAMPLES 5
+#define TEST_STEP 1e-6
+#define TEST_TOLERANCE 1e-9
+#define TEST_FD_TOLERANCE 1e-5
+
+typedef struct test_graph test_graph;
+
+struct test_graph{
+	const char *name;
+	rad_func *(*build)(void);
+	unsigned int num_inputs;
+};
+
+static unsigned int num_checks = 0;
+static unsigned int num_failures = 0;
+static unsigned int num_square_calls = 0;
+
+static void check(const char *graph, const char *what, unsigned int index, double value, double expected, double tolerance){
+	num_checks++;
+	if(!(fabs(value - expected) <= tolerance*(1 + fabs(expected)))){
+		num_failures++;
+		printf("FAIL %s: %s [%u] is %.17g, expected %.17g\n", graph, what, index, value, expected);
+	}
+}
+
+static void check_true(const char *graph, const char *what, bool value){
+	num_checks++;
+	if(!value){
+		num_failures++;
+		printf("FAIL %s: %s\n", graph, what);
+	}
+}
+
+static void check_vector(const char *graph, const char *what, double *values, double *expected, unsigned int length, double tolerance){
+	unsigned int i;
+
+	for(i = 0; i < length; i++){
+		check(graph, what, i, values[i], expected[i], tolerance);
+	}
+}
+
+static double square(double *inputs, double *grad){
+	grad[0] = 2*inputs[0];
+	return inputs[0]*inputs[0];
+}
+
+static double scaled_sin(double *inputs, double *grad){
+	grad[0] = sin(inputs[1]);
+	grad[1] = inputs[0]*cos(inputs[1]);
+	return inputs[0]*sin(inputs[1]);
+}
+
+static double counted_square(double *inputs, double *grad){
+	num_square_calls++;
+	return square(inputs, grad);
+}
+
+static void square_batch(double **inputs, double *outputs, double **partials, unsigned int n){
+	unsigned int i;
+
+	for(i = 0; i < n; i++){
+		outputs[i] = inputs[0][i]*inputs[0][i];
+		if(partials != NULL){
+			partials[0][i] = 2*inputs[0][i];
+		}
+	}
+}
+
+static void scaled_sin_batch(double **inputs, double *outputs, double **partials, unsigned int n){
+	unsigned int i;
+
+	for(i = 0; i < n; i++){
+		outputs[i] = inputs[0][i]*sin(inputs[1][i]);
+	}
+}
+
+static void scaled_sin_vjp(double **inputs, double *outputs, double *adjoints, double **input_adjoints, unsigned int n){
+	unsigned int i;
+
+	for(i = 0; i < n; i++){
+		input_adjoints[0][i] += adjoints[i]*sin(inputs[1][i]);
+		input_adjoints[1][i] += adjoints[i]*inputs[0][i]*cos(inputs[1][i]);
+	}
+}
+
+//sin(x0*x1) used four times, once through a chain which shares it again
+static rad_func *shared_graph(void){
+	rad_func *s;
+	rad_func *t;
+
+	s = rad_sin(rad_multiply(rad_input(0), rad_input(1)));
+	t = rad_add(rad_copy(s), rad_input(2));
+	return rad_add(rad_add(rad_multiply(rad_copy(s), rad_copy(s)), rad_multiply(rad_copy(t), rad_input(0))), rad_divide(rad_exp(s), rad_add(rad_const(1), rad_multiply(rad_copy(t), t))));
+}
+
+//One function composed at two places and also used directly
+static rad_func *composition_graph(void){
+	rad_func *g;
+
+	g = rad_add(rad_multiply(rad_tanh(rad_input(0)), rad_input(1)), rad_pow(rad_input(0), rad_const(2)));
+	return rad_add(rad_add(rad_composition(rad_copy(g), 2, rad_multiply(rad_input(0), rad_input(2)), rad_input(1)), rad_composition(rad_copy(g), 2, rad_input(2), rad_sqrt(rad_add(rad_input(0), rad_const(1))))), g);
+}
+
+static rad_func *custom_graph(void){
+	rad_func *s;
+
+	s = rad_sigmoid(rad_subtract(rad_input(0), rad_input(2)));
+	return rad_add(rad_multiply(rad_custom(square, 1, rad_add(rad_input(0), rad_input(1))), rad_custom(scaled_sin, 2, rad_copy(s), rad_input(2))), rad_log(rad_add(rad_custom(square, 1, s), rad_const(1))));
+}
+
+//Inputs 0 to 2 feed a layer of four sigmoids with weights from input 3 and a layer of one output with weights
+//from input 19
+static rad_func *dense_graph(void){
+	rad_func *inputs[4];
+	rad_func *layer;
+	rad_func *output;
+	unsigned int i;
+
+	for(i = 0; i < 3; i++){
+		inputs[i] = rad_input(i);
+	}
+	layer = rad_dense(3, 3, 4, inputs);
+	for(i = 0; i < 4; i++){
+		inputs[i] = rad_sigmoid(rad_dense_output(rad_copy(layer), i));
+	}
+	rad_discard(layer);
+	layer = rad_dense(19, 4, 1, inputs);
+	output = rad_dense_output(rad_copy(layer), 0);
+	rad_discard(layer);
+
+	return rad_multiply(rad_copy(output), output);
+}
+
+//A function of inputs 0 and 1 with a dense layer weighted by inputs 2 to 7 and a custom function, composed twice
+//and also used directly
+static rad_func *mixed_graph(void){
+	rad_func *inputs[2];
+	rad_func *layer;
+	rad_func *g;
+
+	inputs[0] = rad_input(0);
+	inputs[1] = rad_sin(rad_input(1));
+	layer = rad_dense(2, 2, 2, inputs);
+	g = rad_add(rad_sigmoid(rad_dense_output(rad_copy(layer), 0)), rad_custom(scaled_sin, 2, rad_dense_output(rad_copy(layer), 1), rad_input(0)));
+	rad_discard(layer);
+
+	return rad_add(rad_multiply(rad_composition(rad_copy(g), 8, rad_multiply(rad_input(0), rad_input(1)), rad_input(1), rad_input(2), rad_input(3), rad_input(4), rad_input(5), rad_input(6), rad_input(7)),
+		rad_composition(rad_copy(g), 8, rad_copy(g), rad_input(0), rad_input(2), rad_input(3), rad_input(4), rad_input(5), rad_input(6), rad_input(7))), g);
+}
+
+//A custom function and a dense layer used directly and through a composition evaluated after them, whose nested
+//evaluation overwrites their arrays
+static rad_func *shared_arrays_graph(void){
+	rad_func *inputs[1];
+	rad_func *layer;
+	rad_func *f;
+
+	inputs[0] = rad_custom(square, 1, rad_input(0));
+	layer = rad_dense(1, 1, 2, inputs);
+	f = rad_multiply(rad_dense_output(rad_copy(layer), 0), rad_dense_output(layer, 1));
+	return rad_add(rad_copy(f), rad_composition(f, 5, rad_multiply(rad_const(2), rad_input(0)), rad_input(1), rad_input(2), rad_input(3), rad_input(4)));
+}
+
+//Two outputs of a dense layer of input 0, with weights from inputs 1 to 4
+static rad_func *dense_function(void){
+	rad_func *inputs[1];
+	rad_func *layer;
+
+	inputs[0] = rad_input(0);
+	layer = rad_dense(1, 1, 2, inputs);
+	return rad_multiply(rad_dense_output(rad_copy(layer), 0), rad_tanh(rad_dense_output(layer, 1)));
+}
+
+//The dense function composed with weights computed from other inputs, in an order unlike the layer's own
+static rad_func *dense_composition_graph(void){
+	return rad_add(rad_composition(dense_function(), 5, rad_sin(rad_input(0)), rad_input(3), rad_exp(rad_input(1)), rad_multiply(rad_input(2), rad_input(0)), rad_input(1)), rad_input(2));
+}
+
+static const test_graph test_graphs[] = {
+	{"shared", shared_graph, 3},
+	{"composition", composition_graph, 3},
+	{"custom", custom_graph, 3},
+	{"dense", dense_graph, 24},
+	{"mixed", mixed_graph, 8},
+	{"shared arrays", shared_arrays_graph, 5},
+	{"dense composition", dense_composition_graph, 4}
+};
+
+static void test_inputs(double *inputs, unsigned int num_inputs, unsigned int sample){
+	unsigned int i;
+
+	for(i = 0; i < num_inputs; i++){
+		inputs[i] = 0.2 + 0.5*sin(1.7*i + 0.9*sample);
+	}
+}
+
+//Gradient of rad_eval by central differences
+static void finite_gradient(rad_func *func, double *inputs, unsigned int num_inputs, double *gradient){
+	double saved;
+	double high;
+	unsigned int i;
+
+	for(i = 0; i < num_inputs; i++){
+		saved = inputs[i];
+		inputs[i] = saved + TEST_STEP;
+		high = rad_eval(func, inputs);
+		inputs[i] = saved - TEST_STEP;
+		gradient[i] = (high - rad_eval(func, inputs))/(2*TEST_STEP);
+		inputs[i] = saved;
+	}
+}
+
+static double gradient(rad_func *func, double *inputs, unsigned int num_inputs, double *derivatives){
+	memset(derivatives, 0, sizeof(double)*num_inputs);
+	return rad_backward_diff(func, inputs, derivatives);
+}
+
+//Checks a rewritten copy of the function against the original
+static void test_rewrite(const test_graph *graph, const char *what, rad_func *copy, double *inputs, double value, double *expected, double *derivatives){
+	check(graph->name, what, 0, rad_eval(copy, inputs), value, TEST_TOLERANCE);
+	gradient(copy, inputs, graph->num_inputs, derivatives);
+	check_vector(graph->name, what, derivatives, expected, graph->num_inputs, TEST_TOLERANCE);
+	rad_discard(copy);
+}
+
+static void test_graph_evaluators(const test_graph *graph){
+	rad_func *func;
+	rad_func *funcs[2];
+	rad_tape *tape;
+	rad_ctx *ctx;
+	rad_multi *multi;
+	rad_jit *jit;
+	rad_checkpoint *checkpoint;
+	rad_csr *csr;
+	double *inputs;
+	double *expected;
+	double *derivatives;
+	double *tangents;
+	double *hessian;
+	double *matrix;
+	double *samples;
+	double *outputs;
+	double *sample_grads;
+	double *batch_expected;
+	double value;
+	double deriv;
+	double cotangent[2];
+	size_t budgets[3] = {1024, 16384, 1 << 20};
+	unsigned int changed;
+	unsigned int n;
+	unsigned int i;
+	unsigned int j;
+	unsigned int k;
+
+	n = graph->num_inputs;
+	func = graph->build();
+	inputs = malloc(sizeof(double)*n);
+	expected = malloc(sizeof(double)*n);
+	derivatives = malloc(sizeof(double)*n);
+	tangents = malloc(sizeof(double)*n*n);
+	hessian = malloc(sizeof(double)*n*n);
+	matrix = malloc(sizeof(double)*n*n);
+	samples = malloc(sizeof(double)*n*TEST_SAMPLES);
+	outputs = malloc(sizeof(double)*TEST_SAMPLES);
+	sample_grads = malloc(sizeof(double)*n*TEST_SAMPLES);
+	batch_expected = malloc(sizeof(double)*n*TEST_SAMPLES);
+	test_inputs(inputs, n, 0);
+
+	//The reference gradient, checked against finite differences
+	value = gradient(func, inputs, n, expected);
+	check(graph->name, "rad_backward_diff value", 0, value, rad_eval(func, inputs), TEST_TOLERANCE);
+	finite_gradient(func, inputs, n, derivatives);
+	check_vector(graph->name, "rad_backward_diff against finite differences", expected, derivatives, n, TEST_FD_TOLERANCE);
+
+	//Graph evaluators
+	for(i = 0; i < n; i++){
+		check(graph->name, "rad_forward_diff", i, rad_forward_diff(func, inputs, i, &deriv), expected[i], TEST_TOLERANCE);
+		check(graph->name, "rad_forward_diff value", i, deriv, value, TEST_TOLERANCE);
+	}
+	deriv = 0;
+	for(i = 0; i < n; i++){
+		derivatives[i] = cos(3.0*i);
+		deriv += derivatives[i]*expected[i];
+	}
+	check(graph->name, "rad_forward_grad", 0, rad_forward_grad(func, inputs, derivatives, NULL), deriv, TEST_TOLERANCE);
+	memset(tangents, 0, sizeof(double)*n*n);
+	for(i = 0; i < n; i++){
+		tangents[i*n + i] = 1;
+	}
+	check(graph->name, "rad_forward_grad_vec value", 0, rad_forward_grad_vec(func, inputs, tangents, n, derivatives), value, TEST_TOLERANCE);
+	check_vector(graph->name, "rad_forward_grad_vec", derivatives, expected, n, TEST_TOLERANCE);
+
+	//Tapes and contexts
+	tape = rad_compile(func);
+	check_true(graph->name, "rad_compile", tape != NULL);
+	if(tape != NULL){
+		check(graph->name, "rad_tape_eval", 0, rad_tape_eval(tape, inputs), value, TEST_TOLERANCE);
+		memset(derivatives, 0, sizeof(double)*n);
+		check(graph->name, "rad_tape_backward value", 0, rad_tape_backward(tape, inputs, derivatives), value, TEST_TOLERANCE);
+		check_vector(graph->name, "rad_tape_backward", derivatives, expected, n, TEST_TOLERANCE);
+
+		ctx = rad_ctx_create(tape);
+		memset(derivatives, 0, sizeof(double)*n);
+		rad_backward_diff_ctx(ctx, inputs, derivatives);
+		check_vector(graph->name, "rad_backward_diff_ctx", derivatives, expected, n, TEST_TOLERANCE);
+		for(changed = 0; changed < n; changed += 3){
+			inputs[changed] += 0.25;
+			gradient(func, inputs, n, sample_grads);
+			memset(derivatives, 0, sizeof(double)*n);
+			check(graph->name, "rad_backward_diff_incremental_ctx value", changed, rad_backward_diff_incremental_ctx(ctx, inputs, &changed, 1, derivatives), rad_eval(func, inputs), TEST_TOLERANCE);
+			check_vector(graph->name, "rad_backward_diff_incremental_ctx", derivatives, sample_grads, n, TEST_TOLERANCE);
+			inputs[changed] -= 0.25;
+			check(graph->name, "rad_eval_incremental_ctx", changed, rad_eval_incremental_ctx(ctx, inputs, &changed, 1), value, TEST_TOLERANCE);
+		}
+		rad_ctx_free(ctx);
+
+		for(i = 0; i < sizeof(budgets)/sizeof(size_t); i++){
+			checkpoint = rad_checkpoint_create(tape, budgets[i]);
+			check_true(graph->name, "rad_checkpoint_create", checkpoint != NULL);
+			if(checkpoint != NULL){
+				memset(derivatives, 0, sizeof(double)*n);
+				check(graph->name, "rad_checkpoint_backward value", i, rad_checkpoint_backward(checkpoint, inputs, derivatives), value, TEST_TOLERANCE);
+				check_vector(graph->name, "rad_checkpoint_backward", derivatives, expected, n, TEST_TOLERANCE);
+				rad_checkpoint_free(checkpoint);
+			}
+		}
+		rad_tape_free(tape);
+	}
+
+	//Batches, against one backward pass per sample
+	for(k = 0; k < TEST_SAMPLES; k++){
+		test_inputs(samples + k*n, n, k);
+		gradient(func, samples + k*n, n, batch_expected + k*n);
+	}
+	check_true(graph->name, "rad_backward_diff_batch", rad_backward_diff_batch(func, samples, TEST_SAMPLES, n, outputs, memset(sample_grads, 0, sizeof(double)*n*TEST_SAMPLES), n));
+	for(k = 0; k < TEST_SAMPLES; k++){
+		check(graph->name, "rad_backward_diff_batch value", k, outputs[k], rad_eval(func, samples + k*n), TEST_TOLERANCE);
+	}
+	check_vector(graph->name, "rad_backward_diff_batch", sample_grads, batch_expected, n*TEST_SAMPLES, TEST_TOLERANCE);
+	check_true(graph->name, "rad_eval_batch", rad_eval_batch(func, samples, TEST_SAMPLES, n, sample_grads));
+	check_vector(graph->name, "rad_eval_batch", sample_grads, outputs, TEST_SAMPLES, TEST_TOLERANCE);
+	memset(expected, 0, sizeof(double)*n);
+	for(k = 0; k < TEST_SAMPLES; k++){
+		for(i = 0; i < n; i++){
+			expected[i] += batch_expected[k*n + i];
+		}
+	}
+	memset(derivatives, 0, sizeof(double)*n);
+	rad_backward_diff_parallel(func, samples, TEST_SAMPLES, n, derivatives, 2);
+	check_vector(graph->name, "rad_backward_diff_parallel", derivatives, expected, n, TEST_TOLERANCE);
+	gradient(func, inputs, n, expected);
+
+	//Second order, against finite differences of the gradient
+	for(j = 0; j < n; j++){
+		inputs[j] += TEST_STEP;
+		gradient(func, inputs, n, derivatives);
+		inputs[j] -= 2*TEST_STEP;
+		gradient(func, inputs, n, tangents);
+		inputs[j] += TEST_STEP;
+		for(i = 0; i < n; i++){
+			matrix[i*n + j] = (derivatives[i] - tangents[i])/(2*TEST_STEP);
+		}
+	}
+	check_true(graph->name, "rad_hessian", rad_hessian(func, inputs, hessian, false));
+	check_vector(graph->name, "rad_hessian against finite differences", hessian, matrix, n*n, 1e-4);
+	check_true(graph->name, "rad_hessian sparse", rad_hessian(func, inputs, matrix, true));
+	check_vector(graph->name, "rad_hessian sparse", matrix, hessian, n*n, TEST_TOLERANCE);
+	for(i = 0; i < n; i++){
+		derivatives[i] = sin(2.0*i + 1);
+	}
+	memset(tangents, 0, sizeof(double)*n);
+	check(graph->name, "rad_hvp value", 0, rad_hvp(func, inputs, derivatives, tangents), value, TEST_TOLERANCE);
+	for(i = 0; i < n; i++){
+		deriv = 0;
+		for(j = 0; j < n; j++){
+			deriv += hessian[i*n + j]*derivatives[j];
+		}
+		check(graph->name, "rad_hvp", i, tangents[i], deriv, TEST_TOLERANCE);
+	}
+	csr = rad_hessian_sparse(func, inputs);
+	check_true(graph->name, "rad_hessian_sparse", csr != NULL);
+	if(csr != NULL){
+		memset(matrix, 0, sizeof(double)*n*n);
+		for(i = 0; i < csr->num_rows; i++){
+			for(j = csr->row_start[i]; j < csr->row_start[i + 1]; j++){
+				matrix[i*n + csr->col_index[j]] = csr->values[j];
+			}
+		}
+		check_vector(graph->name, "rad_hessian_sparse", matrix, hessian, n*n, TEST_TOLERANCE);
+		rad_csr_free(csr);
+	}
+
+	//Several outputs sharing the function
+	funcs[0] = rad_copy(func);
+	funcs[1] = rad_multiply(rad_copy(func), rad_copy(func));
+	multi = rad_multi_create(funcs, 2);
+	check_true(graph->name, "rad_multi_create", multi != NULL);
+	if(multi != NULL){
+		rad_jacobian(multi, inputs, tangents);
+		for(i = 0; i < n; i++){
+			check(graph->name, "rad_jacobian", i, tangents[i], expected[i], TEST_TOLERANCE);
+			check(graph->name, "rad_jacobian", n + i, tangents[n + i], 2*value*expected[i], TEST_TOLERANCE);
+		}
+		cotangent[0] = 1;
+		cotangent[1] = 0.5;
+		memset(derivatives, 0, sizeof(double)*n);
+		rad_vjp(multi, inputs, cotangent, derivatives);
+		for(i = 0; i < n; i++){
+			check(graph->name, "rad_vjp", i, derivatives[i], (1 + value)*expected[i], TEST_TOLERANCE);
+		}
+		rad_multi_free(multi);
+	}
+
+	jit = rad_jit_create(func);
+	check_true(graph->name, "rad_jit_create", jit != NULL);
+	if(jit != NULL){
+		check(graph->name, "rad_jit_eval", 0, rad_jit_eval(jit, inputs), value, TEST_TOLERANCE);
+		memset(derivatives, 0, sizeof(double)*n);
+		rad_jit_backward(jit, inputs, derivatives);
+		check_vector(graph->name, "rad_jit_backward", derivatives, expected, n, TEST_TOLERANCE);
+		rad_jit_free(jit);
+	}
+
+	//Copies and rewrites
+	check_true(graph->name, "rad_save", rad_save(func, "rad_test.tmp"));
+	test_rewrite(graph, "rad_load", rad_load("rad_test.tmp"), inputs, value, expected, derivatives);
+	remove("rad_test.tmp");
+	test_rewrite(graph, "rad_deep_copy", rad_deep_copy(func), inputs, value, expected, derivatives);
+	test_rewrite(graph, "rad_simplify", rad_simplify(rad_deep_copy(func)), inputs, value, expected, derivatives);
+	test_rewrite(graph, "rad_inline", rad_inline(rad_deep_copy(func)), inputs, value, expected, derivatives);
+	rad_cse(func);
+	test_rewrite(graph, "rad_cse", rad_copy(func), inputs, value, expected, derivatives);
+
+	rad_discard(func);
+	free(inputs);
+	free(expected);
+	free(derivatives);
+	free(tangents);
+	free(hessian);
+	free(matrix);
+	free(samples);
+	free(outputs);
+	free(sample_grads);
+	free(batch_expected);
+}
+
+//A custom function used three times is called once per evaluation
+static void test_shared_once(void){
+	rad_func *s;
+	rad_func *f;
+	double input = 3;
+	double derivative = 0;
+
+	s = rad_custom(counted_square, 1, rad_input(0));
+	f = rad_add(rad_multiply(rad_copy(s), rad_copy(s)), s);
+	num_square_calls = 0;
+	check("shared once", "rad_eval", 0, rad_eval(f, &input), 90, TEST_TOLERANCE);
+	check("shared once", "rad_eval calls", 0, num_square_calls, 1, 0);
+	num_square_calls = 0;
+	check("shared once", "rad_backward_diff", 0, rad_backward_diff(f, &input, &derivative), 90, TEST_TOLERANCE);
+	check("shared once", "rad_backward_diff", 1, derivative, 114, TEST_TOLERANCE);
+	check("shared once", "rad_backward_diff calls", 0, num_square_calls, 1, 0);
+	num_square_calls = 0;
+	check("shared once", "rad_forward_diff", 0, rad_forward_diff(f, &input, 0, NULL), 114, TEST_TOLERANCE);
+	check("shared once", "rad_forward_diff calls", 0, num_square_calls, 1, 0);
+	rad_discard(f);
+}
+
+//The derivative of x^2 + (2x)^2 at 3, with the composition evaluated after the custom function
+static void test_shared_custom(void){
+	rad_func *f;
+	double input = 3;
+	double derivative = 0;
+
+	f = rad_custom(square, 1, rad_input(0));
+	f = rad_add(rad_copy(f), rad_composition(f, 1, rad_multiply(rad_const(2), rad_input(0))));
+	check("shared custom", "rad_backward_diff", 0, rad_backward_diff(f, &input, &derivative), 45, TEST_TOLERANCE);
+	check("shared custom", "rad_backward_diff", 1, derivative, 30, TEST_TOLERANCE);
+	check("shared custom", "rad_forward_diff", 0, rad_forward_diff(f, &input, 0, NULL), 30, TEST_TOLERANCE);
+	rad_discard(f);
+}
+
+//A graph built in an arena evaluates like one built with malloc
+static void test_arena(void){
+	rad_arena *arena;
+	rad_func *func;
+	double inputs[3];
+	double expected[3];
+	double derivatives[3];
+	double value;
+
+	test_inputs(inputs, 3, 0);
+	func = shared_graph();
+	value = gradient(func, inputs, 3, expected);
+	rad_discard(func);
+	arena = rad_arena_create(4096);
+	check_true("arena", "rad_arena_create", arena != NULL);
+	if(arena == NULL){
+		return;
+	}
+	rad_set_allocator(rad_arena_alloc, rad_arena_free, arena);
+	func = shared_graph();
+	check("arena", "rad_backward_diff value", 0, gradient(func, inputs, 3, derivatives), value, TEST_TOLERANCE);
+	check_vector("arena", "rad_backward_diff", derivatives, expected, 3, TEST_TOLERANCE);
+	rad_discard(func);
+	rad_set_allocator(NULL, NULL, NULL);
+	rad_arena_destroy(arena);
+}
+
+//A chain of additions deeper than the thread stack would allow by recursion
+static void test_deep_chain(void){
+	rad_func *func;
+	rad_func *copy;
+	double inputs[2] = {0.5, 2};
+	double derivatives[2] = {0, 0};
+	double expected[2] = {1, 1};
+	unsigned int depth = 1000000;
+	unsigned int i;
+
+	func = rad_input(0);
+	for(i = 0; i < depth; i++){
+		func = rad_add(func, rad_multiply(rad_const(1.0/depth), rad_input(1)));
+	}
+	check("deep chain", "rad_eval", 0, rad_eval(func, inputs), 2.5, TEST_TOLERANCE);
+	check("deep chain", "rad_backward_diff value", 0, rad_backward_diff(func, inputs, derivatives), 2.5, TEST_TOLERANCE);
+	check_vector("deep chain", "rad_backward_diff", derivatives, expected, 2, TEST_TOLERANCE);
+	check("deep chain", "rad_forward_diff", 0, rad_forward_diff(func, inputs, 1, NULL), 1, TEST_TOLERANCE);
+	copy = rad_deep_copy(func);
+	check("deep chain", "rad_deep_copy", 0, rad_eval(copy, inputs), 2.5, TEST_TOLERANCE);
+	rad_discard(copy);
+	rad_discard(func);
+}
+
+//Code is only emitted when every custom function has a registered symbol
+static void test_emit(void){
+	rad_func *func;
+	FILE *file;
+
+	file = tmpfile();
+	check_true("emit", "tmpfile", file != NULL);
+	if(file == NULL){
+		return;
+	}
+	func = custom_graph();
+	check_true("emit", "rad_emit_c", rad_emit_c(func, file, "custom"));
+	check_true("emit", "rad_emit_c wrote code", ftell(file) > 0);
+	rad_discard(func);
+	rewind(file);
+	func = rad_custom(counted_square, 1, rad_input(0));
+	check_true("emit", "rad_emit_c without a symbol", !rad_emit_c(func, file, "counted"));
+	rad_discard(func);
+	fclose(file);
+}
+
+//sin(x0*x1)^2 + sin(x0*x1) has 6 unique nodes and 14 if the shared node were copied
+static void test_stats(void){
+	rad_func *s;
+	rad_func *f;
+	rad_graph_stats stats;
+
+	s = rad_sin(rad_multiply(rad_input(0), rad_input(1)));
+	f = rad_add(rad_multiply(rad_copy(s), rad_copy(s)), s);
+	rad_stats(f, &stats);
+	check("stats", "num_unique_nodes", 0, stats.num_unique_nodes, 6, 0);
+	check("stats", "num_nodes", 0, stats.num_nodes, 14, 0);
+	rad_discard(f);
+}
+
+//A composition with fewer arguments than the weights of its dense layer cannot be compiled
+static void test_dense_missing_weights(void){
+	rad_func *f;
+
+	f = rad_composition(dense_function(), 4, rad_input(0), rad_input(1), rad_input(2), rad_input(3));
+	check_true("dense composition", "rad_compile without the last weight", rad_compile(f) == NULL);
+	rad_discard(f);
+}
+
+//Checkpointed reverse mode on an unrolled chain x = x + 0.01*sin(x*w_k), with budgets from the least memory any plan
+//needs to enough for one segment
+static void test_checkpoint_chain(void){
+	rad_func *func;
+	rad_tape *tape;
+	rad_checkpoint *checkpoint;
+	double *inputs;
+	double *expected;
+	double *derivatives;
+	double value;
+	size_t extra[6] = {0, 1 << 12, 1 << 13, 1 << 14, 1 << 16, 1 << 22};
+	size_t least_memory = 0;
+	size_t full_memory = 0;
+	unsigned int n = 4096;
+	unsigned int i;
+
+	func = rad_input(0);
+	for(i = 1; i <= n; i++){
+		func = rad_add(rad_copy(func), rad_multiply(rad_const(0.01), rad_sin(rad_multiply(func, rad_input(i)))));
+	}
+	tape = rad_compile(func);
+	inputs = malloc(sizeof(double)*(n + 1));
+	expected = calloc(n + 1, sizeof(double));
+	derivatives = malloc(sizeof(double)*(n + 1));
+	test_inputs(inputs, n + 1, 0);
+	value = rad_tape_backward(tape, inputs, expected);
+	checkpoint = rad_checkpoint_create(tape, 0);
+	check_true("checkpoint chain", "rad_checkpoint_create", checkpoint != NULL);
+	if(checkpoint != NULL){
+		least_memory = checkpoint->memory;
+		check_true("checkpoint chain", "the tape context is released", tape->ctx == NULL);
+		rad_checkpoint_free(checkpoint);
+	}
+	for(i = 0; i < sizeof(extra)/sizeof(size_t); i++){
+		checkpoint = rad_checkpoint_create(tape, least_memory + extra[i]);
+		check_true("checkpoint chain", "rad_checkpoint_create", checkpoint != NULL);
+		if(checkpoint == NULL){
+			continue;
+		}
+		check_true("checkpoint chain", "memory within the budget", checkpoint->memory <= least_memory + extra[i]);
+		check_true("checkpoint chain", "no less memory than the least", checkpoint->memory >= least_memory);
+		full_memory = checkpoint->memory;
+		memset(derivatives, 0, sizeof(double)*(n + 1));
+		check("checkpoint chain", "rad_checkpoint_backward value", i, rad_checkpoint_backward(checkpoint, inputs, derivatives), value, TEST_TOLERANCE);
+		check_vector("checkpoint chain", "rad_checkpoint_backward", derivatives, expected, n + 1, TEST_TOLERANCE);
+		rad_checkpoint_free(checkpoint);
+	}
+	check_true("checkpoint chain", "segments save most of the 16 bytes per instruction", full_memory - least_memory > 12*(size_t) tape->num_ops);
+
+	rad_tape_free(tape);
+	rad_discard(func);
+	free(inputs);
+	free(expected);
+	free(derivatives);
+}
+
+int main(int argc, char **argv){
+	unsigned int i;
+
+	rad_register_custom(square, "square");
+	rad_register_custom(scaled_sin, "scaled_sin");
+	rad_custom_batch(square, square_batch, NULL);
+	rad_custom_batch(scaled_sin, scaled_sin_batch, scaled_sin_vjp);
+	for(i = 0; i < sizeof(test_graphs)/sizeof(test_graph); i++){
+		test_graph_evaluators(test_graphs + i);
+	}
+	test_shared_once();
+	test_shared_custom();
+	test_arena();
+	test_deep_chain();
+	test_emit();
+	test_stats();
+	test_dense_missing_weights();
+	test_checkpoint_chain();
+	printf("%u checks, %u failed\n", num_checks, num_failures);
+
+	return num_failures != 0;
+}